@@ -0,0 +1,37 @@
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+#include "memory_report.hpp"
+
+/*
+ * Replaces the global operator new and delete of the pl0cc executable so that --mem-report
+ * can count blocks. Until memory::enable() they only add one relaxed load to malloc and free.
+ * The aligned and nothrow forms keep their library versions; the nothrow ones call these.
+ */
+namespace {
+    void* allocate(size_t size) {
+        void* p = std::malloc(size == 0 ? 1 : size);
+        if (p == nullptr) throw std::bad_alloc();
+        if (pl0cc::memory::counting.load(std::memory_order_relaxed)) {
+            pl0cc::memory::noteAllocation(malloc_usable_size(p));
+        }
+        return p;
+    }
+
+    void release(void* p) noexcept {
+        if (p == nullptr) return;
+        if (pl0cc::memory::counting.load(std::memory_order_relaxed)) {
+            pl0cc::memory::noteRelease(malloc_usable_size(p));
+        }
+        std::free(p);
+    }
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
@@ -0,0 +1,383 @@
+#include "artifact_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace pl0cc;
+
+namespace {
+    /*
+     * Entry layout, native byte order:
+     *   "PL0C", u32 format, u64 key high, u64 key low,
+     *   u64 token / symbol / number / string / node counts,
+     *   tokens as (u32 type, i32 seman), each table as (u32 length, bytes),
+     *   tree nodes in preorder as (u32 symbol, u32 child count, u32 token type or NO_TOKEN, i32 seman)
+     */
+    constexpr char MAGIC[4] = {'P', 'L', '0', 'C'};
+    constexpr std::uint32_t FORMAT_VERSION = 1;
+    constexpr std::uint32_t NO_TOKEN = 0xffffffffu;
+    constexpr Symbol NULL_CHILD = EPS - 1;
+    constexpr const char* ENTRY_EXTENSION = ".pl0c";
+    constexpr size_t HEADER_SIZE = 4 + 4 + 8 + 8;
+
+    using Hash = unsigned __int128;
+
+    constexpr Hash FNV_OFFSET = (Hash(0x6c62272e07bb0142ull) << 64) | 0x62b821756295c58dull;
+    constexpr Hash FNV_PRIME = (Hash(0x0000000001000000ull) << 64) | 0x000000000000013bull;
+
+    bool validTokenType(std::uint32_t type) {
+        return type <= std::uint32_t(TokenType::ARROW);
+    }
+
+    // A token type or a named non-terminating symbol
+    bool validSymbol(std::uint32_t symbol) {
+        return validTokenType(symbol) || symbols::symbolToNameMap().count(Symbol(symbol)) != 0;
+    }
+
+    void hashBytes(Hash& hash, std::string_view bytes) {
+        for (unsigned char c : bytes) {
+            hash ^= c;
+            hash *= FNV_PRIME;
+        }
+    }
+
+    template <typename T>
+    void append(std::string& out, T value) {
+        char bytes[sizeof value];
+        std::memcpy(bytes, &value, sizeof value);
+        out.append(bytes, sizeof value);
+    }
+
+    void appendEntry(std::string& out, std::string_view entry) {
+        append<std::uint32_t>(out, std::uint32_t(entry.size()));
+        out += entry;
+    }
+
+    void appendTable(std::string& out, const std::vector<std::string>& table) {
+        for (const std::string& s : table) appendEntry(out, s);
+    }
+
+    // The spellings, which the TokenStorage constructor interns again
+    void appendTable(std::string& out, const StringPool& pool) {
+        for (size_t i = 0; i < pool.size(); i++) appendEntry(out, pool.spelling(i));
+    }
+
+    // Bounds-checked reads from a mapped entry; any overrun clears ok
+    class Cursor {
+    public:
+        Cursor(const char* begin, const char* end) : pos(begin), end(end), ok(true) {}
+
+        template <typename T>
+        T read() {
+            T value {};
+            if (size_t(end - pos) < sizeof value) {
+                ok = false;
+                return value;
+            }
+            std::memcpy(&value, pos, sizeof value);
+            pos += sizeof value;
+            return value;
+        }
+
+        std::vector<std::string> readTable(std::uint64_t count) {
+            std::vector<std::string> table;
+            if (count > std::uint64_t(end - pos)) ok = false;
+            for (std::uint64_t i = 0; ok && i < count; i++) {
+                auto length = read<std::uint32_t>();
+                if (size_t(end - pos) < length) {
+                    ok = false;
+                    break;
+                }
+                table.emplace_back(pos, length);
+                pos += length;
+            }
+            return table;
+        }
+
+        [[nodiscard]] bool good() const { return ok; }
+        [[nodiscard]] bool atEnd() const { return pos == end; }
+        [[nodiscard]] size_t remaining() const { return size_t(end - pos); }
+    private:
+        const char* pos;
+        const char* end;
+        bool ok;
+    };
+
+    // Returns the number of nodes written, null children included
+    std::uint64_t appendTree(std::string& out, const SyntaxTree& root) {
+        std::uint64_t count = 0;
+        std::vector<const SyntaxTree*> pending {&root};
+        while (!pending.empty()) {
+            const SyntaxTree* node = pending.back();
+            pending.pop_back();
+            count++;
+            if (node == nullptr) {
+                append<std::uint32_t>(out, NULL_CHILD);
+                append<std::uint32_t>(out, 0);
+                append<std::uint32_t>(out, NO_TOKEN);
+                append<std::int32_t>(out, -1);
+                continue;
+            }
+            append<std::uint32_t>(out, node->symbol());
+            append<std::uint32_t>(out, std::uint32_t(node->childCount()));
+            append<std::uint32_t>(out, node->token() ? std::uint32_t(node->token()->type) : NO_TOKEN);
+            append<std::int32_t>(out, node->token() ? node->token()->seman : -1);
+            for (size_t i = node->childCount(); i-- > 0;) {
+                pending.push_back(node->childExists(i) ? &node->childAt(i) : nullptr);
+            }
+        }
+        return count;
+    }
+
+    std::optional<SyntaxTree> readTree(Cursor& cursor, std::uint64_t nodeCount) {
+        // Nodes still waiting for children, with the number they still need
+        std::vector<std::pair<SyntaxTree*, std::uint32_t>> open;
+        std::optional<SyntaxTree> root;
+        for (std::uint64_t i = 0; i < nodeCount; i++) {
+            auto symbol = cursor.read<std::uint32_t>();
+            auto childCount = cursor.read<std::uint32_t>();
+            auto tokenType = cursor.read<std::uint32_t>();
+            auto seman = cursor.read<std::int32_t>();
+            if (!cursor.good() || (i > 0 && open.empty())) return std::nullopt;
+
+            std::shared_ptr<SyntaxTree> node;
+            if (symbol != NULL_CHILD) {
+                if (!validSymbol(symbol) || (tokenType != NO_TOKEN && !validTokenType(tokenType))) return std::nullopt;
+                node = std::make_shared<SyntaxTree>(Symbol(symbol));
+                if (tokenType != NO_TOKEN) node->setTokenData(Token(TokenType(tokenType), seman));
+            }
+
+            SyntaxTree* attached;
+            if (i == 0) {
+                if (node == nullptr) return std::nullopt;
+                root.emplace(std::move(*node));
+                attached = &*root;
+            } else {
+                open.back().first->addChild(node);
+                attached = node.get();
+                if (--open.back().second == 0) open.pop_back();
+            }
+            if (childCount > 0) {
+                if (attached == nullptr) return std::nullopt;
+                open.emplace_back(attached, childCount);
+            }
+        }
+        if (!open.empty() || !root) return std::nullopt;
+        return root;
+    }
+
+    std::optional<ArtifactCache::Artifact> decode(const char* begin, const char* end, const CacheKey& key) {
+        Cursor cursor(begin, end);
+        auto magic = cursor.read<std::uint32_t>();
+        if (!cursor.good() || std::memcmp(&magic, MAGIC, sizeof magic) != 0) return std::nullopt;
+        if (cursor.read<std::uint32_t>() != FORMAT_VERSION) return std::nullopt;
+        if (cursor.read<std::uint64_t>() != key.high || cursor.read<std::uint64_t>() != key.low) return std::nullopt;
+
+        auto tokenCount = cursor.read<std::uint64_t>();
+        auto symbolCount = cursor.read<std::uint64_t>();
+        auto numberCount = cursor.read<std::uint64_t>();
+        auto stringCount = cursor.read<std::uint64_t>();
+        auto nodeCount = cursor.read<std::uint64_t>();
+        if (!cursor.good() || tokenCount > cursor.remaining() / 8) return std::nullopt;
+
+        std::vector<Token> tokens;
+        tokens.reserve(tokenCount);
+        for (std::uint64_t i = 0; i < tokenCount; i++) {
+            auto type = cursor.read<std::uint32_t>();
+            auto seman = cursor.read<std::int32_t>();
+            // A damaged entry is a miss, not a token type that later code indexes tables with
+            if (!validTokenType(type)) return std::nullopt;
+            tokens.emplace_back(TokenType(type), seman);
+        }
+        auto symbols = cursor.readTable(symbolCount);
+        auto numbers = cursor.readTable(numberCount);
+        auto strings = cursor.readTable(stringCount);
+        if (!cursor.good() || nodeCount > cursor.remaining() / 16) return std::nullopt;
+
+        auto tree = readTree(cursor, nodeCount);
+        if (!tree || !cursor.good() || !cursor.atEnd()) return std::nullopt;
+        return ArtifactCache::Artifact {
+            TokenStorage(std::move(tokens), std::move(symbols), std::move(numbers), std::move(strings)),
+            std::move(*tree)
+        };
+    }
+}
+
+std::string CacheKey::hex() const {
+    static const char digits[] = "0123456789abcdef";
+    std::string text(32, '0');
+    for (int i = 0; i < 16; i++) {
+        text[size_t(15 - i)] = digits[(high >> (4 * i)) & 0xf];
+        text[size_t(31 - i)] = digits[(low >> (4 * i)) & 0xf];
+    }
+    return text;
+}
+
+ArtifactCache::ArtifactCache(std::filesystem::path directory, std::string version, std::uint64_t sizeLimit) :
+    directory(std::move(directory)), version(std::move(version)), sizeLimit(sizeLimit),
+    evictionMutex(), unscannedBytes(0), scanned(false) {
+    std::filesystem::create_directories(this->directory);
+}
+
+CacheKey ArtifactCache::keyOf(std::string_view source, std::string_view parser) const {
+    Hash hash = FNV_OFFSET;
+    hashBytes(hash, version);
+    hashBytes(hash, std::string_view("\0", 1));
+    hashBytes(hash, parser);
+    hashBytes(hash, std::string_view("\0", 1));
+    hashBytes(hash, source);
+    return CacheKey {std::uint64_t(hash >> 64), std::uint64_t(hash)};
+}
+
+std::filesystem::path ArtifactCache::entryPath(const CacheKey& key) const {
+    return directory / (key.hex() + ENTRY_EXTENSION);
+}
+
+std::optional<ArtifactCache::Artifact> ArtifactCache::load(const CacheKey& key) const {
+    std::string path = entryPath(key).string();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return std::nullopt;
+
+    std::optional<Artifact> artifact;
+    struct stat info {};
+    if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* mapped = ::mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            const char* begin = static_cast<const char*>(mapped);
+            artifact = decode(begin, begin + info.st_size, key);
+            ::munmap(mapped, size_t(info.st_size));
+        }
+    }
+    // The modification time orders entries for eviction
+    if (artifact) ::futimens(fd, nullptr);
+    ::close(fd);
+
+    if (!artifact) ::unlink(path.c_str());
+    return artifact;
+}
+
+bool ArtifactCache::contains(const CacheKey& key) const {
+    std::string path = entryPath(key).string();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    char header[HEADER_SIZE];
+    bool found = ::pread(fd, header, sizeof header, 0) == ssize_t(sizeof header) &&
+                 std::memcmp(header, MAGIC, sizeof MAGIC) == 0;
+    if (found) {
+        std::uint32_t format;
+        std::uint64_t high, low;
+        std::memcpy(&format, header + 4, sizeof format);
+        std::memcpy(&high, header + 8, sizeof high);
+        std::memcpy(&low, header + 16, sizeof low);
+        found = format == FORMAT_VERSION && high == key.high && low == key.low;
+    }
+    if (found) ::futimens(fd, nullptr);
+    ::close(fd);
+    return found;
+}
+
+void ArtifactCache::store(const CacheKey& key, const TokenStorage& tokens, const SyntaxTree& tree) const {
+    std::string entry(MAGIC, sizeof MAGIC);
+    append<std::uint32_t>(entry, FORMAT_VERSION);
+    append<std::uint64_t>(entry, key.high);
+    append<std::uint64_t>(entry, key.low);
+    append<std::uint64_t>(entry, tokens.size());
+    append<std::uint64_t>(entry, tokens.symbolTable().size());
+    append<std::uint64_t>(entry, tokens.numberTable().size());
+    append<std::uint64_t>(entry, tokens.stringPool().size());
+    size_t nodeCountAt = entry.size();
+    append<std::uint64_t>(entry, 0);
+    for (Token token : tokens) {
+        append<std::uint32_t>(entry, std::uint32_t(token.type));
+        append<std::int32_t>(entry, token.seman);
+    }
+    appendTable(entry, tokens.symbolTable());
+    appendTable(entry, tokens.numberTable());
+    appendTable(entry, tokens.stringPool());
+    std::uint64_t nodeCount = appendTree(entry, tree);
+    std::memcpy(&entry[nodeCountAt], &nodeCount, sizeof nodeCount);
+
+    // Readers only ever see complete entries: write aside, then rename over
+    std::filesystem::path path = entryPath(key);
+    std::filesystem::path temporary = path;
+    temporary += ".tmp." + std::to_string(::getpid()) + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        out.write(entry.data(), std::streamsize(entry.size()));
+        if (!out) {
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(evictionMutex);
+    unscannedBytes += entry.size();
+    if (!scanned || unscannedBytes > sizeLimit / 8) {
+        evict();
+        scanned = true;
+        unscannedBytes = 0;
+    }
+}
+
+void ArtifactCache::evict() const {
+    struct Entry {
+        std::filesystem::file_time_type lastUse;
+        std::uint64_t size;
+        std::filesystem::path path;
+    };
+    std::vector<Entry> entries;
+    std::uint64_t total = 0;
+
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        if (it->path().extension() != ENTRY_EXTENSION) continue;
+        std::error_code statError;
+        auto size = it->file_size(statError);
+        auto lastUse = it->last_write_time(statError);
+        if (statError) continue;
+        entries.push_back(Entry {lastUse, size, it->path()});
+        total += size;
+    }
+    if (total <= sizeLimit) return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+    for (const Entry& entry : entries) {
+        if (total <= sizeLimit) break;
+        // Another process may have evicted it already; a reader that mapped it keeps its copy
+        std::filesystem::remove(entry.path, error);
+        total -= entry.size;
+    }
+}
+
+std::string pl0cc::grammarFingerprint(const Syntax& syntax) {
+    Hash hash = FNV_OFFSET;
+    auto hashSymbol = [&hash](Symbol symbol) {
+        char bytes[sizeof symbol];
+        std::memcpy(bytes, &symbol, sizeof symbol);
+        hashBytes(hash, std::string_view(bytes, sizeof bytes));
+    };
+    hashSymbol(syntax.start());
+    for (const auto& [left, right] : syntax.conducts()) {
+        hashSymbol(left);
+        for (Symbol symbol : right) hashSymbol(symbol);
+        hashSymbol(EPS);
+    }
+    return CacheKey {std::uint64_t(hash >> 64), std::uint64_t(hash)}.hex();
+}
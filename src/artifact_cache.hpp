@@ -0,0 +1,63 @@
+#ifndef PL0CC_ARTIFACT_CACHE_HPP
+#define PL0CC_ARTIFACT_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "lexer.hpp"
+#include "syntax.hpp"
+
+namespace pl0cc {
+    // 128-bit FNV-1a hash of an input and everything its compiled form depends on
+    struct CacheKey {
+        std::uint64_t high, low;
+
+        [[nodiscard]] std::string hex() const;
+    };
+
+    /*
+     * Token streams and syntax trees of compiled inputs, one <key>.pl0c file each under a
+     * directory that several threads and processes may share. Keys cover the source bytes, the
+     * compiler version and the parser, so stale entries are never hit and need no invalidation.
+     * Once the directory grows past its size limit the least recently used entries are removed.
+     */
+    class ArtifactCache {
+    public:
+        struct Artifact {
+            TokenStorage tokens;
+            SyntaxTree tree;
+        };
+
+        // version names the compiler and grammars; see grammarFingerprint()
+        ArtifactCache(std::filesystem::path directory, std::string version, std::uint64_t sizeLimit);
+
+        [[nodiscard]] CacheKey keyOf(std::string_view source, std::string_view parser) const;
+
+        // Maps the entry and rebuilds it without lexing or parsing; nullopt on a miss or a damaged entry
+        [[nodiscard]] std::optional<Artifact> load(const CacheKey& key) const;
+        // Checks and touches the entry without decoding it, for compiles that only need to know the parse succeeded
+        [[nodiscard]] bool contains(const CacheKey& key) const;
+        void store(const CacheKey& key, const TokenStorage& tokens, const SyntaxTree& tree) const;
+    private:
+        std::filesystem::path directory;
+        std::string version;
+        std::uint64_t sizeLimit;
+
+        // The directory is scanned after the first store and then after every sizeLimit / 8 bytes stored
+        mutable std::mutex evictionMutex;
+        mutable std::uint64_t unscannedBytes;
+        mutable bool scanned;
+
+        [[nodiscard]] std::filesystem::path entryPath(const CacheKey& key) const;
+        void evict() const;
+    };
+
+    // Changes whenever a production of syntax does
+    std::string grammarFingerprint(const Syntax& syntax);
+}
+
+#endif // PL0CC_ARTIFACT_CACHE_HPP
@@ -0,0 +1,358 @@
+#include "ast.hpp"
+#include "output_buffer.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace pl0cc;
+using namespace pl0cc::symbols;
+
+namespace {
+    constexpr const char* kindMap[] {
+        "PROGRAM", "FUNCTION", "VARDEF", "BLOCK", "IF", "WHILE", "RETURN", "BREAK", "CONTINUE",
+        "EXPR_STMT", "BINARY", "UNARY", "CALL", "SYMBOL_REF", "LITERAL"
+    };
+
+    class Lowering {
+    public:
+        explicit Lowering(Ast& ast) : ast(ast) {}
+
+        void program(const SyntaxTree* node);
+    private:
+        Ast& ast;
+
+        void function(const SyntaxTree& node);
+        void varDef(const SyntaxTree& node);
+        void statement(const SyntaxTree& node);
+        void expression(const SyntaxTree& node);
+        void operandChain(const SyntaxTree& node);
+        void foldChain(const std::vector<const SyntaxTree*>& operands, const std::vector<Token>& ops, bool rightAssociative, size_t from, size_t to);
+        void collectArguments(const SyntaxTree& node, std::vector<const SyntaxTree*>& args);
+
+        static std::vector<const SyntaxTree*> listItems(const SyntaxTree& node);
+        static const SyntaxTree& child(const SyntaxTree& node, size_t index);
+        static Token tokenOf(const SyntaxTree& node);
+        [[noreturn]] static void unexpected(const SyntaxTree& node);
+    };
+
+    bool isChainSymbol(Symbol s) {
+        return s == L1_EXPR || s == L2_EXPR || s == L3_EXPR || s == L4_EXPR || s == L5_EXPR || s == L6_EXPR;
+    }
+
+    void Lowering::program(const SyntaxTree* node) {
+        Ast::Index root = ast.open(AstKind::PROGRAM);
+        for (const SyntaxTree* part : listItems(*node)) {
+            if (child(*part, 0).symbol() == FNDEF) {
+                function(child(*part, 0));
+            } else {
+                varDef(child(*part, 0));
+            }
+        }
+        ast.close(root);
+    }
+
+    void Lowering::function(const SyntaxTree& node) {
+        // FN SYMBOL ( VIRTVARDEFS_E ) -> TYPE STMT
+        Token name = tokenOf(child(node, 1));
+        Token type = tokenOf(child(child(node, 6), 0));
+        Ast::Index idx = ast.open(AstKind::FUNCTION, uint8_t(type.type), name.seman);
+
+        const SyntaxTree& params = child(node, 3);
+        if (params.childCount() > 0) {
+            const SyntaxTree* defs = &child(params, 0);
+            if (child(*defs, 0).symbol() == VIRTVARDEFS || defs->childCount() == 1) {
+                // VIRTVARDEFS -> VIRTVARDEFS , VARDEF | VARDEF
+                std::vector<const SyntaxTree*> paramList;
+                while (defs->childCount() == 3) {
+                    paramList.push_back(&child(*defs, 2));
+                    defs = &child(*defs, 0);
+                }
+                paramList.push_back(&child(*defs, 0));
+                std::for_each(paramList.rbegin(), paramList.rend(), [&](const SyntaxTree* def) { varDef(*def); });
+            } else {
+                // VIRTVARDEFS -> VARDEF VIRTVARDEFS_P, VIRTVARDEFS_P -> , VIRTVARDEFS | EPS
+                while (true) {
+                    varDef(child(*defs, 0));
+                    const SyntaxTree& tail = child(*defs, 1);
+                    if (tail.childCount() == 0) break;
+                    defs = &child(tail, 1);
+                }
+            }
+        }
+
+        statement(child(node, 7));
+        ast.close(idx);
+    }
+
+    void Lowering::varDef(const SyntaxTree& node) {
+        Token type = tokenOf(child(child(node, 0), 0));
+        Token name = tokenOf(child(node, 1));
+        ast.close(ast.open(AstKind::VARDEF, uint8_t(type.type), name.seman));
+    }
+
+    void Lowering::statement(const SyntaxTree& node) {
+        const SyntaxTree& first = child(node, 0);
+        Ast::Index idx;
+
+        switch (first.symbol()) {
+            case VARDEF:
+                varDef(first);
+                return;
+            case EXPR:
+                idx = ast.open(AstKind::EXPR_STMT);
+                expression(first);
+                break;
+            case IFSTMT:
+                // IF ( EXPR ) STMT ELSECLAUSE
+                idx = ast.open(AstKind::IF);
+                expression(child(first, 2));
+                statement(child(first, 4));
+                if (child(first, 5).childCount() > 0) statement(child(child(first, 5), 1));
+                break;
+            case WHILESTMT:
+                // WHILE ( EXPR ) STMT
+                idx = ast.open(AstKind::WHILE);
+                expression(child(first, 2));
+                statement(child(first, 4));
+                break;
+            case Symbol(TokenType::LLBRACKET): {
+                idx = ast.open(AstKind::BLOCK);
+                for (const SyntaxTree* stmt : listItems(child(node, 1))) statement(*stmt);
+                break;
+            }
+            case Symbol(TokenType::RETURN):
+                idx = ast.open(AstKind::RETURN);
+                expression(child(node, 1));
+                break;
+            case Symbol(TokenType::BREAK):
+                idx = ast.open(AstKind::BREAK);
+                break;
+            case Symbol(TokenType::CONTINUE):
+                idx = ast.open(AstKind::CONTINUE);
+                break;
+            default:
+                unexpected(first);
+        }
+        ast.close(idx);
+    }
+
+    void Lowering::expression(const SyntaxTree& node) {
+        Symbol s = node.symbol();
+        if (s == EXPR) {
+            expression(child(node, 0));
+        } else if (isChainSymbol(s) && node.childCount() == 2) {
+            operandChain(node);
+        } else if (isChainSymbol(s) && node.childCount() == 1) {
+            expression(child(node, 0));
+        } else if (isChainSymbol(s) && node.childCount() == 3) {
+            // Left-recursive levels of genLrSyntax(): Ln_EXPR -> Ln_EXPR BI_OPn Ln+1_EXPR
+            Ast::Index idx = ast.open(AstKind::BINARY, uint8_t(tokenOf(child(child(node, 1), 0)).type));
+            expression(child(node, 0));
+            expression(child(node, 2));
+            ast.close(idx);
+        } else if (s == BI_EXPR) {
+            Ast::Index idx = ast.open(AstKind::BINARY, uint8_t(tokenOf(child(node, 1)).type));
+            expression(child(node, 0));
+            expression(child(node, 2));
+            ast.close(idx);
+        } else if (s == L7_EXPR) {
+            // SINGLE_EXPR | UNARY_OP SINGLE_EXPR
+            if (node.childCount() == 1) {
+                expression(child(node, 0));
+            } else {
+                Ast::Index idx = ast.open(AstKind::UNARY, uint8_t(tokenOf(child(child(node, 0), 0)).type));
+                expression(child(node, 1));
+                ast.close(idx);
+            }
+        } else if (s == SINGLE_EXPR) {
+            // LITERAL | SYM_OR_FCAL | ( EXPR )
+            expression(child(node, node.childCount() == 1 ? 0 : 1));
+        } else if (s == LITERAL) {
+            Token literal = tokenOf(child(node, 0));
+            ast.close(ast.open(AstKind::LITERAL, uint8_t(literal.type), literal.seman));
+        } else if (s == SYM_OR_FCAL) {
+            Token name = tokenOf(child(node, 0));
+            const SyntaxTree& args = child(node, 1);
+            if (args.childCount() == 0) {
+                ast.close(ast.open(AstKind::SYMBOL_REF, 0, name.seman));
+                return;
+            }
+
+            Ast::Index idx = ast.open(AstKind::CALL, 0, name.seman);
+            std::vector<const SyntaxTree*> argList;
+            collectArguments(child(args, 1), argList);
+            for (const SyntaxTree* arg : argList) expression(*arg);
+            ast.close(idx);
+        } else {
+            unexpected(node);
+        }
+    }
+
+    // Ln_EXPR -> Ln+1_EXPR Ln_EXPR_P, Ln_EXPR_P -> BI_OPn Ln_EXPR | EPS
+    void Lowering::operandChain(const SyntaxTree& node) {
+        std::vector<const SyntaxTree*> operands;
+        std::vector<Token> ops;
+
+        const SyntaxTree* chain = &node;
+        while (true) {
+            operands.push_back(&child(*chain, 0));
+            const SyntaxTree& tail = child(*chain, 1);
+            if (tail.childCount() == 0) break;
+            ops.push_back(tokenOf(child(child(tail, 0), 0)));
+            chain = &child(tail, 1);
+        }
+
+        // Assignment is the only right associative level
+        foldChain(operands, ops, node.symbol() == L2_EXPR, 0, operands.size() - 1);
+    }
+
+    void Lowering::foldChain(const std::vector<const SyntaxTree*>& operands, const std::vector<Token>& ops, bool rightAssociative, size_t from, size_t to) {
+        if (from == to) {
+            expression(*operands[from]);
+            return;
+        }
+
+        size_t split = rightAssociative ? from : to - 1;
+        Ast::Index idx = ast.open(AstKind::BINARY, uint8_t(ops[split].type));
+        foldChain(operands, ops, rightAssociative, from, split);
+        foldChain(operands, ops, rightAssociative, split + 1, to);
+        ast.close(idx);
+    }
+
+    // Top level comma operators separate call arguments
+    void Lowering::collectArguments(const SyntaxTree& node, std::vector<const SyntaxTree*>& args) {
+        if (node.symbol() == EXPR) {
+            collectArguments(child(node, 0), args);
+        } else if (node.symbol() == L1_EXPR && node.childCount() != 2) {
+            if (node.childCount() == 3) {
+                collectArguments(child(node, 0), args);
+                args.push_back(&child(node, 2));
+            } else {
+                args.push_back(&child(node, 0));
+            }
+        } else if (node.symbol() == L1_EXPR) {
+            const SyntaxTree* chain = &node;
+            while (true) {
+                args.push_back(&child(*chain, 0));
+                const SyntaxTree& tail = child(*chain, 1);
+                if (tail.childCount() == 0) break;
+                chain = &child(tail, 1);
+            }
+        } else if (node.symbol() == BI_EXPR && tokenOf(child(node, 1)).type == TokenType::COMMA) {
+            collectArguments(child(node, 0), args);
+            collectArguments(child(node, 2), args);
+        } else {
+            args.push_back(&node);
+        }
+    }
+
+    // Items of LIST -> ITEM LIST | EPS, or of the left-recursive LIST -> LIST ITEM | EPS
+    std::vector<const SyntaxTree*> Lowering::listItems(const SyntaxTree& node) {
+        std::vector<const SyntaxTree*> items;
+        bool leftRecursive = false;
+
+        const SyntaxTree* list = &node;
+        while (list->childCount() > 0) {
+            if (child(*list, 0).symbol() == node.symbol()) {
+                leftRecursive = true;
+                items.push_back(&child(*list, 1));
+                list = &child(*list, 0);
+            } else {
+                items.push_back(&child(*list, 0));
+                list = &child(*list, 1);
+            }
+        }
+
+        if (leftRecursive) std::reverse(items.begin(), items.end());
+        return items;
+    }
+
+    const SyntaxTree& Lowering::child(const SyntaxTree& node, size_t index) {
+        if (!node.childExists(index)) unexpected(node);
+        return node.childAt(index);
+    }
+
+    Token Lowering::tokenOf(const SyntaxTree& node) {
+        if (!node.token().has_value()) unexpected(node);
+        return *node.token();
+    }
+
+    void Lowering::unexpected(const SyntaxTree& node) {
+        throw std::runtime_error("Unexpected syntax tree node " + symbols::symbolToName(node.symbol()));
+    }
+}
+
+std::string pl0cc::astKindName(AstKind kind) {
+    return kindMap[static_cast<int>(kind)];
+}
+
+size_t Ast::childCount(Index idx) const {
+    size_t count = 0;
+    for (Index ch = idx + 1; ch < nodes[idx].end; ch = nodes[ch].end) count++;
+    return count;
+}
+
+Ast::Index Ast::open(AstKind kind, uint8_t op, uint32_t value) {
+    nodes.push_back({kind, op, value, NONE});
+    return Index(nodes.size() - 1);
+}
+
+void Ast::close(Index idx) {
+    nodes[idx].end = Index(nodes.size());
+}
+
+void Ast::serializeTo(std::ostream& os) const {
+    OutputBuffer out(os);
+    serializeTo(out);
+}
+
+void Ast::serializeTo(OutputBuffer& out) const {
+    PL0CC_TRACE_SCOPE("serialize_ast");
+    std::vector<Index> ends;
+    std::string bars;
+    for (Index idx = 0; idx < nodes.size(); idx++) {
+        while (!ends.empty() && ends.back() <= idx) ends.pop_back();
+
+        const AstNode& node = nodes[idx];
+        if (bars.size() < ends.size()) bars.resize(ends.size(), '|');
+        out.put(std::string_view(bars.data(), ends.size()));
+        out.put(kindMap[static_cast<int>(node.kind)]);
+        switch (node.kind) {
+            case AstKind::FUNCTION:
+            case AstKind::VARDEF:
+                out.put(' ');
+                out.put(tokenTypeName(TokenType(node.op)));
+                out.put(" symbol ");
+                out.putUnsigned(node.value);
+                break;
+            case AstKind::CALL:
+            case AstKind::SYMBOL_REF:
+                out.put(" symbol ");
+                out.putUnsigned(node.value);
+                break;
+            case AstKind::LITERAL:
+                out.put(' ');
+                out.put(tokenTypeName(TokenType(node.op)));
+                out.put(' ');
+                out.putUnsigned(node.value);
+                break;
+            case AstKind::BINARY:
+            case AstKind::UNARY:
+                out.put(' ');
+                out.put(tokenTypeName(TokenType(node.op)));
+                break;
+            default:
+                break;
+        }
+        out.put('\n');
+
+        ends.push_back(node.end);
+    }
+}
+
+Ast pl0cc::lowerSyntaxTree(const SyntaxTree& tree) {
+    Ast ast;
+    Lowering(ast).program(&tree);
+    return ast;
+}
@@ -0,0 +1,90 @@
+#ifndef PL0CC_AST_HPP
+#define PL0CC_AST_HPP
+
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "lexer.hpp"
+#include "syntax.hpp"
+
+namespace pl0cc {
+    enum class AstKind : uint8_t {
+        PROGRAM, FUNCTION, VARDEF, BLOCK, IF, WHILE, RETURN, BREAK, CONTINUE,
+        EXPR_STMT, BINARY, UNARY, CALL, SYMBOL_REF, LITERAL
+    };
+
+    std::string astKindName(AstKind kind);
+
+    /*
+     * Nodes are stored in pre-order, so the children of node i start at i+1
+     * and the subtree of node i ends right before index `end`.
+     *
+     * `op` holds a TokenType: the operator of BINARY/UNARY, the type of
+     * VARDEF/FUNCTION and NUMBER/STRING of LITERAL.
+     * `value` holds a token seman: the symbol of FUNCTION/VARDEF/CALL/SYMBOL_REF
+     * and the constant index of LITERAL.
+     */
+    struct AstNode {
+        AstKind kind;
+        uint8_t op;
+        uint32_t value;
+        uint32_t end;
+    };
+
+    class Ast {
+    public:
+        using Index = uint32_t;
+        constexpr static const Index NONE = std::numeric_limits<uint32_t>::max();
+
+        class ChildIterator {
+        public:
+            ChildIterator(const Ast* ast, Index idx) : ast(ast), idx(idx) {}
+            Index operator*() const { return idx; }
+            ChildIterator& operator++() { idx = ast->nodes[idx].end; return *this; }
+            bool operator!=(const ChildIterator& it) const { return idx != it.idx; }
+        private:
+            const Ast* ast;
+            Index idx;
+        };
+
+        class ChildRange {
+        public:
+            ChildRange(const Ast* ast, Index parent) : ast(ast), parent(parent) {}
+            [[nodiscard]] ChildIterator begin() const { return {ast, parent + 1}; }
+            [[nodiscard]] ChildIterator end() const { return {ast, ast->nodes[parent].end}; }
+        private:
+            const Ast* ast;
+            Index parent;
+        };
+
+        Ast() = default;
+
+        [[nodiscard]] size_t size() const { return nodes.size(); }
+        [[nodiscard]] bool empty() const { return nodes.empty(); }
+        const AstNode& operator[](Index idx) const { return nodes[idx]; }
+
+        [[nodiscard]] Index root() const { return nodes.empty() ? NONE : 0; }
+        [[nodiscard]] ChildRange children(Index idx) const { return {this, idx}; }
+        [[nodiscard]] size_t childCount(Index idx) const;
+
+        [[nodiscard]] auto begin() const -> std::vector<AstNode>::const_iterator { return nodes.begin(); }
+        [[nodiscard]] auto end() const -> std::vector<AstNode>::const_iterator { return nodes.end(); }
+
+        Index open(AstKind kind, uint8_t op = 0, uint32_t value = 0);
+        void close(Index idx);
+        void reserve(size_t count) { nodes.reserve(count); }
+
+        void serializeTo(std::ostream& os) const;
+        void serializeTo(OutputBuffer& out) const;
+    private:
+        std::vector<AstNode> nodes;
+    };
+
+    // Accepts concrete trees built with or without an OperatorPrecedenceTable
+    Ast lowerSyntaxTree(const SyntaxTree& tree);
+}
+
+#endif // PL0CC_AST_HPP
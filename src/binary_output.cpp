@@ -0,0 +1,252 @@
+#include "binary_output.hpp"
+#include "trace.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace pl0cc;
+
+namespace {
+    constexpr size_t SECTION_ALIGNMENT = 8;
+
+    constexpr size_t elementSize(BinarySection s) {
+        switch (s) {
+            case BinarySection::TOKEN_TYPES:
+            case BinarySection::SYMBOL_BYTES:
+            case BinarySection::NUMBER_BYTES:
+            case BinarySection::STRING_BYTES:
+                return 1;
+            case BinarySection::NODES:
+                return sizeof(BinaryNode);
+            default:
+                return 4;
+        }
+    }
+
+    bool validTokenType(std::uint32_t type) {
+        return type <= std::uint32_t(TokenType::ARROW);
+    }
+
+    // A token type or a named non-terminating symbol
+    bool validSymbol(std::uint32_t symbol) {
+        return validTokenType(symbol) || symbols::symbolToNameMap().count(Symbol(symbol)) != 0;
+    }
+
+    size_t aligned(size_t offset) {
+        return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+    }
+
+    template <typename T>
+    std::string_view bytesOf(const T* values, size_t count) {
+        return std::string_view(reinterpret_cast<const char*>(values), count * sizeof(T));
+    }
+
+    // The string pool written as the spellings of its entries, like the other tables
+    std::vector<std::string_view> spellings(const StringPool& pool) {
+        std::vector<std::string_view> table;
+        table.reserve(pool.size());
+        for (size_t i = 0; i < pool.size(); i++) table.push_back(pool.spelling(i));
+        return table;
+    }
+
+    template <typename Entry>
+    std::vector<std::uint32_t> poolOffsets(const std::vector<Entry>& pool) {
+        std::vector<std::uint32_t> offsets {0};
+        for (std::string_view entry : pool) offsets.push_back(std::uint32_t(offsets.back() + entry.size()));
+        return offsets;
+    }
+
+    // Breadth-first, so that the children of each node end up next to each other
+    std::vector<BinaryNode> flattenTree(const SyntaxTree& root) {
+        std::vector<const SyntaxTree*> order {&root};
+        std::vector<BinaryNode> nodes;
+        for (size_t i = 0; i < order.size(); i++) {
+            const SyntaxTree* tree = order[i];
+            BinaryNode node {tree->symbol(), BinaryNode::NO_TOKEN, -1, std::uint32_t(order.size()), 0};
+            if (tree->token()) {
+                node.tokenType = std::uint32_t(tree->token()->type);
+                node.seman = tree->token()->seman;
+            }
+            for (size_t ch = 0; ch < tree->childCount(); ch++) {
+                if (!tree->childExists(ch)) continue;
+                order.push_back(&tree->childAt(ch));
+                node.childCount++;
+            }
+            nodes.push_back(node);
+        }
+        return nodes;
+    }
+}
+
+void pl0cc::writeBinaryOutput(OutputBuffer& out, const TokenStorage& tokens, const SyntaxTree& tree) {
+    PL0CC_TRACE_SCOPE("write_binary");
+    std::vector<std::uint8_t> types;
+    std::vector<std::int32_t> semans;
+    types.reserve(tokens.size());
+    semans.reserve(tokens.size());
+    for (Token token : tokens) {
+        types.push_back(std::uint8_t(token.type));
+        semans.push_back(token.seman);
+    }
+    std::vector<std::uint32_t> symbolOffsets = poolOffsets(tokens.symbolTable());
+    std::vector<std::uint32_t> numberOffsets = poolOffsets(tokens.numberTable());
+    std::vector<std::string_view> strings = spellings(tokens.stringPool());
+    std::vector<std::uint32_t> stringOffsets = poolOffsets(strings);
+    std::vector<BinaryNode> nodes = flattenTree(tree);
+
+    const size_t counts[size_t(BinarySection::COUNT)] = {
+        types.size(), semans.size(),
+        symbolOffsets.size(), symbolOffsets.back(),
+        numberOffsets.size(), numberOffsets.back(),
+        stringOffsets.size(), stringOffsets.back(),
+        nodes.size()
+    };
+    BinaryHeader header {};
+    std::memcpy(header.magic, BinaryHeader::MAGIC, sizeof header.magic);
+    header.version = BinaryHeader::VERSION;
+    header.byteOrder = BinaryHeader::ORDER_MARK;
+    size_t offset = aligned(sizeof header);
+    for (size_t s = 0; s < size_t(BinarySection::COUNT); s++) {
+        header.sections[s] = {offset, counts[s]};
+        offset = aligned(offset + counts[s] * elementSize(BinarySection(s)));
+    }
+
+    size_t written = 0;
+    auto writeSection = [&out, &written](std::string_view bytes) {
+        out.putRepeated('\0', aligned(written) - written);
+        written = aligned(written);
+        out.put(bytes);
+        written += bytes.size();
+    };
+
+    writeSection(bytesOf(&header, 1));
+    writeSection(bytesOf(types.data(), types.size()));
+    writeSection(bytesOf(semans.data(), semans.size()));
+    auto writePool = [&](const std::vector<std::uint32_t>& offsets, const auto& pool) {
+        writeSection(bytesOf(offsets.data(), offsets.size()));
+        // Only the start of the pool bytes is aligned
+        writeSection({});
+        for (std::string_view entry : pool) {
+            out.put(entry);
+            written += entry.size();
+        }
+    };
+    writePool(symbolOffsets, tokens.symbolTable());
+    writePool(numberOffsets, tokens.numberTable());
+    writePool(stringOffsets, strings);
+    writeSection(bytesOf(nodes.data(), nodes.size()));
+}
+
+BinaryOutputView::BinaryOutputView(const void* data, size_t size) :
+    data(static_cast<const char*>(data)), size(size), header(static_cast<const BinaryHeader*>(data)) {
+    if (reinterpret_cast<std::uintptr_t>(data) % SECTION_ALIGNMENT != 0) {
+        throw std::runtime_error("Binary output must be 8-byte aligned in memory");
+    }
+    if (size < sizeof(BinaryHeader) || std::memcmp(header->magic, BinaryHeader::MAGIC, sizeof header->magic) != 0) {
+        throw std::runtime_error("Not a pl0cc binary output");
+    }
+    if (header->version != BinaryHeader::VERSION) {
+        throw std::runtime_error("Unsupported binary output version " + std::to_string(header->version));
+    }
+    if (header->byteOrder != BinaryHeader::ORDER_MARK) {
+        throw std::runtime_error("Binary output was written with another byte order");
+    }
+    for (size_t s = 0; s < size_t(BinarySection::COUNT); s++) {
+        const BinarySectionEntry& entry = header->sections[s];
+        size_t element = elementSize(BinarySection(s));
+        if (entry.offset % SECTION_ALIGNMENT != 0 || entry.offset > size || entry.count > (size - entry.offset) / element) {
+            throw std::runtime_error("Binary output section " + std::to_string(s) + " is out of bounds");
+        }
+    }
+    for (BinarySection offsets : {BinarySection::SYMBOL_OFFSETS, BinarySection::NUMBER_OFFSETS, BinarySection::STRING_OFFSETS}) {
+        if (section(offsets).count == 0) throw std::runtime_error("Binary output pool has no offsets");
+    }
+    if (section(BinarySection::TOKEN_SEMANS).count != tokenCount()) {
+        throw std::runtime_error("Binary output token arrays differ in length");
+    }
+}
+
+TokenType BinaryOutputView::tokenType(size_t index) const {
+    if (index >= tokenCount()) throw std::runtime_error("Token index out of range");
+    auto type = std::uint8_t(data[section(BinarySection::TOKEN_TYPES).offset + index]);
+    if (!validTokenType(type)) throw std::runtime_error("Malformed token type");
+    return TokenType(type);
+}
+
+int BinaryOutputView::tokenSeman(size_t index) const {
+    if (index >= tokenCount()) throw std::runtime_error("Token index out of range");
+    return reinterpret_cast<const std::int32_t*>(data + section(BinarySection::TOKEN_SEMANS).offset)[index];
+}
+
+std::string_view BinaryOutputView::symbol(size_t index) const {
+    return poolEntry(BinarySection::SYMBOL_OFFSETS, index);
+}
+
+std::string_view BinaryOutputView::numberConstant(size_t index) const {
+    return poolEntry(BinarySection::NUMBER_OFFSETS, index);
+}
+
+std::string_view BinaryOutputView::stringConstant(size_t index) const {
+    return poolEntry(BinarySection::STRING_OFFSETS, index);
+}
+
+const BinaryNode& BinaryOutputView::node(size_t index) const {
+    if (index >= nodeCount()) throw std::runtime_error("Node index out of range");
+    const BinaryNode& node = reinterpret_cast<const BinaryNode*>(data + section(BinarySection::NODES).offset)[index];
+    if (!validSymbol(node.symbol) || (node.hasToken() && !validTokenType(node.tokenType))) {
+        throw std::runtime_error("Malformed node symbol");
+    }
+    return node;
+}
+
+size_t BinaryOutputView::child(size_t parent, size_t index) const {
+    const BinaryNode& node = this->node(parent);
+    if (index >= node.childCount) throw std::runtime_error("Child index out of range");
+    size_t child = size_t(node.firstChild) + index;
+    // Children always come after their parent, so walks cannot loop
+    if (child <= parent || child >= nodeCount()) throw std::runtime_error("Malformed child range");
+    return child;
+}
+
+size_t BinaryOutputView::poolSize(BinarySection offsets) const {
+    return section(offsets).count - 1;
+}
+
+std::string_view BinaryOutputView::poolEntry(BinarySection offsets, size_t index) const {
+    if (index >= poolSize(offsets)) throw std::runtime_error("Pool index out of range");
+    const auto* bounds = reinterpret_cast<const std::uint32_t*>(data + section(offsets).offset);
+    const BinarySectionEntry& bytes = section(BinarySection(std::uint32_t(offsets) + 1));
+    if (bounds[index] > bounds[index + 1] || bounds[index + 1] > bytes.count) {
+        throw std::runtime_error("Malformed pool offsets");
+    }
+    return std::string_view(data + bytes.offset + bounds[index], bounds[index + 1] - bounds[index]);
+}
+
+MappedFile::MappedFile(const std::string& path) : address(nullptr), length(0) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("Cannot open " + path);
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat " + path);
+    }
+    length = size_t(info.st_size);
+    if (length > 0) {
+        address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        address = nullptr;
+        throw std::runtime_error("Cannot map " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (address != nullptr) ::munmap(address, length);
+}
@@ -0,0 +1,122 @@
+#ifndef PL0CC_BINARY_OUTPUT_HPP
+#define PL0CC_BINARY_OUTPUT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "lexer.hpp"
+#include "output_buffer.hpp"
+#include "syntax.hpp"
+
+namespace pl0cc {
+    /*
+     * --emit=binary output: a header of section offsets followed by 8-byte aligned arrays, so a
+     * mapped file can be read in place. Integers are in the writer's byte order, which byteOrder
+     * records so that readers can refuse a foreign one.
+     *
+     *   TOKEN_TYPES      u8 per token
+     *   TOKEN_SEMANS     i32 per token, -1 where the text dump prints '^'
+     *   *_OFFSETS        u32 per pool entry plus one; entry i is bytes [offsets[i], offsets[i+1])
+     *   *_BYTES          the pool entries back to back, without terminators
+     *   NODES            BinaryNode per syntax tree node in breadth-first order, root first,
+     *                    so the children of every node are one contiguous range
+     *
+     * Null children of the syntax tree are left out, as in the text dump.
+     */
+    enum class BinarySection : std::uint32_t {
+        TOKEN_TYPES, TOKEN_SEMANS,
+        SYMBOL_OFFSETS, SYMBOL_BYTES,
+        NUMBER_OFFSETS, NUMBER_BYTES,
+        STRING_OFFSETS, STRING_BYTES,
+        NODES,
+        COUNT
+    };
+
+    struct BinarySectionEntry {
+        std::uint64_t offset;   // From the start of the file
+        std::uint64_t count;    // Elements, not bytes
+    };
+
+    struct BinaryHeader {
+        static constexpr char MAGIC[4] = {'P', 'L', '0', 'B'};
+        static constexpr std::uint32_t VERSION = 1;
+        static constexpr std::uint32_t ORDER_MARK = 0x01020304;
+
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t byteOrder;
+        std::uint32_t reserved;
+        BinarySectionEntry sections[size_t(BinarySection::COUNT)];
+    };
+
+    struct BinaryNode {
+        static constexpr std::uint32_t NO_TOKEN = 0xffffffffu;
+
+        std::uint32_t symbol;
+        std::uint32_t tokenType;    // NO_TOKEN for nonterminals
+        std::int32_t seman;
+        std::uint32_t firstChild;   // Index into NODES
+        std::uint32_t childCount;
+
+        [[nodiscard]] bool hasToken() const { return tokenType != NO_TOKEN; }
+    };
+
+    void writeBinaryOutput(OutputBuffer& out, const TokenStorage& tokens, const SyntaxTree& tree);
+
+    /*
+     * Reads a --emit=binary file in place. Construction checks the header and section bounds
+     * only; accessors check what they index, so nothing is scanned up front.
+     * Every accessor throws std::runtime_error on malformed data.
+     */
+    class BinaryOutputView {
+    public:
+        BinaryOutputView(const void* data, size_t size);
+
+        [[nodiscard]] size_t tokenCount() const { return section(BinarySection::TOKEN_TYPES).count; }
+        [[nodiscard]] TokenType tokenType(size_t index) const;
+        [[nodiscard]] int tokenSeman(size_t index) const;
+
+        [[nodiscard]] size_t symbolCount() const { return poolSize(BinarySection::SYMBOL_OFFSETS); }
+        [[nodiscard]] std::string_view symbol(size_t index) const;
+        [[nodiscard]] size_t numberCount() const { return poolSize(BinarySection::NUMBER_OFFSETS); }
+        [[nodiscard]] std::string_view numberConstant(size_t index) const;
+        [[nodiscard]] size_t stringCount() const { return poolSize(BinarySection::STRING_OFFSETS); }
+        [[nodiscard]] std::string_view stringConstant(size_t index) const;
+
+        [[nodiscard]] size_t nodeCount() const { return section(BinarySection::NODES).count; }
+        [[nodiscard]] const BinaryNode& node(size_t index) const;
+        // Index of the index-th child of node parent
+        [[nodiscard]] size_t child(size_t parent, size_t index) const;
+    private:
+        const char* data;
+        size_t size;
+        const BinaryHeader* header;
+
+        [[nodiscard]] const BinarySectionEntry& section(BinarySection s) const {
+            return header->sections[size_t(s)];
+        }
+        [[nodiscard]] size_t poolSize(BinarySection offsets) const;
+        [[nodiscard]] std::string_view poolEntry(BinarySection offsets, size_t index) const;
+    };
+
+    // Read-only mapping of a whole file
+    class MappedFile {
+    public:
+        // Throws std::runtime_error if the file cannot be opened or mapped
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        [[nodiscard]] const void* data() const { return address; }
+        [[nodiscard]] size_t size() const { return length; }
+    private:
+        void* address;
+        size_t length;
+    };
+}
+
+#endif // PL0CC_BINARY_OUTPUT_HPP
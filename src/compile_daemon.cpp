@@ -0,0 +1,313 @@
+#include "compile_daemon.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace pl0cc;
+
+namespace {
+    constexpr const char* PROTOCOL_HEADER = "pl0cc 1";
+
+    volatile std::sig_atomic_t signalled = 0;
+
+    void onSignal(int) {
+        signalled = 1;
+    }
+
+    sockaddr_un socketAddress(const std::string& path) {
+        sockaddr_un address {};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof address.sun_path) throw std::runtime_error("Socket path is too long: " + path);
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return address;
+    }
+
+    // Connected socket, or -1 if nobody listens on path
+    int connectTo(const std::string& path) {
+        sockaddr_un address = socketAddress(path);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof address) != 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Whether the process at the other end of a connected socket runs as this user
+    bool peerIsThisUser(int fd) {
+        ucred credentials {};
+        socklen_t length = sizeof credentials;
+        return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 && credentials.uid == ::getuid();
+    }
+
+    // Creates path if needed; another user must not be able to replace what it holds
+    void makePrivateDirectory(const std::string& path) {
+        if (::mkdir(path.c_str(), 0700) != 0 && errno != EEXIST) {
+            throw std::runtime_error("Cannot create " + path + ": " + std::strerror(errno));
+        }
+        struct stat info {};
+        if (::lstat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) || info.st_uid != ::getuid() ||
+            (info.st_mode & 077) != 0) {
+            throw std::runtime_error(path + " is not a directory private to this user");
+        }
+    }
+
+    bool sendAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += sent;
+            size -= size_t(sent);
+        }
+        return true;
+    }
+
+    bool sendAll(int fd, const std::string& data) {
+        return sendAll(fd, data.data(), data.size());
+    }
+
+    class SocketReader {
+    public:
+        explicit SocketReader(int fd) : fd(fd), buffer(), pos(0) {}
+
+        // Reads up to '\n' and drops it; false at end of stream
+        bool readLine(std::string& line) {
+            while (true) {
+                size_t end = buffer.find('\n', pos);
+                if (end != std::string::npos) {
+                    line.assign(buffer, pos, end - pos);
+                    pos = end + 1;
+                    return true;
+                }
+                if (!fill()) return false;
+            }
+        }
+
+        bool readBytes(size_t count, std::string& out) {
+            while (buffer.size() - pos < count) {
+                if (!fill()) return false;
+            }
+            out.assign(buffer, pos, count);
+            pos += count;
+            return true;
+        }
+    private:
+        int fd;
+        std::string buffer;
+        size_t pos;
+
+        bool fill() {
+            buffer.erase(0, pos);
+            pos = 0;
+            char chunk[4096];
+            while (true) {
+                ssize_t got = ::recv(fd, chunk, sizeof chunk, 0);
+                if (got < 0 && errno == EINTR) continue;
+                if (got <= 0) return false;
+                buffer.append(chunk, size_t(got));
+                return true;
+            }
+        }
+    };
+
+    // Sends what is written to it as one "log <n>" frame per flush
+    class LogFrameBuf : public std::streambuf {
+    public:
+        explicit LogFrameBuf(int fd) : fd(fd), pending() {}
+    protected:
+        int_type overflow(int_type ch) override {
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) pending.push_back(traits_type::to_char_type(ch));
+            return traits_type::not_eof(ch);
+        }
+
+        std::streamsize xsputn(const char* s, std::streamsize n) override {
+            pending.append(s, size_t(n));
+            return n;
+        }
+
+        // A client that went away only loses its diagnostics; the compile itself goes on
+        int sync() override {
+            if (pending.empty()) return 0;
+            sendAll(fd, "log " + std::to_string(pending.size()) + "\n");
+            sendAll(fd, pending);
+            pending.clear();
+            return 0;
+        }
+    private:
+        int fd;
+        std::string pending;
+    };
+
+    bool startsWith(const std::string& line, const char* prefix) {
+        return line.compare(0, std::strlen(prefix), prefix) == 0;
+    }
+
+    std::string encodeRequest(const CompileRequest& request, const char* command) {
+        std::string message = std::string(PROTOCOL_HEADER) + "\n";
+        for (const std::string& flag : request.flags) message += "flag " + flag + "\n";
+        for (size_t i = 0; i < request.inputs.size(); i++) {
+            message += "file " + request.inputs[i] + "\t" + (i < request.outputs.size() ? request.outputs[i] : "") + "\n";
+        }
+        return message + command + "\n";
+    }
+
+    int exchange(const std::string& socketPath, const std::string& message, std::ostream& log) {
+        int fd = connectTo(socketPath);
+        if (fd < 0) throw std::runtime_error("No pl0cc daemon is listening on " + socketPath);
+        if (!peerIsThisUser(fd)) {
+            ::close(fd);
+            throw std::runtime_error("The process listening on " + socketPath + " belongs to another user");
+        }
+        if (!sendAll(fd, message)) {
+            ::close(fd);
+            throw std::runtime_error("Cannot send the request to " + socketPath);
+        }
+
+        SocketReader reader(fd);
+        std::string line, chunk;
+        while (reader.readLine(line)) {
+            if (startsWith(line, "log ")) {
+                if (!reader.readBytes(std::stoul(line.substr(4)), chunk)) break;
+                log << chunk << std::flush;
+            } else if (startsWith(line, "exit ")) {
+                ::close(fd);
+                return std::stoi(line.substr(5));
+            } else {
+                break;
+            }
+        }
+        ::close(fd);
+        throw std::runtime_error("The pl0cc daemon closed the connection");
+    }
+}
+
+CompileDaemon::CompileDaemon(std::string socketPath, Handler handler) :
+    socketPath(std::move(socketPath)), handler(std::move(handler)), listenFd(-1), stopRequested(false),
+    connectionMutex(), connectionsClosed(), openConnections(0) {
+    int existing = connectTo(this->socketPath);
+    if (existing >= 0) {
+        ::close(existing);
+        throw std::runtime_error("A pl0cc daemon is already listening on " + this->socketPath);
+    }
+    // Left over by a daemon that did not exit cleanly
+    ::unlink(this->socketPath.c_str());
+
+    sockaddr_un address = socketAddress(this->socketPath);
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 ||
+        ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof address) != 0 ||
+        ::chmod(this->socketPath.c_str(), 0600) != 0 ||
+        ::listen(listenFd, SOMAXCONN) != 0) {
+        std::string reason = std::strerror(errno);
+        if (listenFd >= 0) ::close(listenFd);
+        throw std::runtime_error("Cannot listen on " + this->socketPath + ": " + reason);
+    }
+}
+
+CompileDaemon::~CompileDaemon() {
+    ::close(listenFd);
+    ::unlink(socketPath.c_str());
+}
+
+void CompileDaemon::serve() {
+    struct sigaction action {};
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+
+    while (!stopRequested && !signalled) {
+        pollfd listening {listenFd, POLLIN, 0};
+        // The timeout bounds how long a stop request from a connection thread waits to be noticed
+        if (::poll(&listening, 1, 200) <= 0) continue;
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) continue;
+        // Requests name files to write, so only the daemon's own user may send them
+        if (!peerIsThisUser(fd)) {
+            ::close(fd);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(connectionMutex);
+            openConnections++;
+        }
+        std::thread([this, fd] {
+            serveConnection(fd);
+            ::close(fd);
+            std::lock_guard<std::mutex> lock(connectionMutex);
+            if (--openConnections == 0) connectionsClosed.notify_all();
+        }).detach();
+    }
+
+    std::unique_lock<std::mutex> lock(connectionMutex);
+    connectionsClosed.wait(lock, [this] { return openConnections == 0; });
+}
+
+void CompileDaemon::serveConnection(int fd) {
+    SocketReader reader(fd);
+    std::string line;
+    if (!reader.readLine(line) || line != PROTOCOL_HEADER) return;
+
+    CompileRequest request;
+    while (reader.readLine(line)) {
+        if (startsWith(line, "flag ")) {
+            request.flags.push_back(line.substr(5));
+        } else if (startsWith(line, "file ")) {
+            size_t tab = line.find('\t');
+            request.inputs.push_back(line.substr(5, tab == std::string::npos ? std::string::npos : tab - 5));
+            request.outputs.push_back(tab == std::string::npos ? "" : line.substr(tab + 1));
+        } else if (line == "compile") {
+            LogFrameBuf frames(fd);
+            std::ostream client(&frames);
+            int status;
+            try {
+                status = handler(request, client);
+            } catch (const std::exception& e) {
+                client << "pl0cc: daemon error: " << e.what() << '\n';
+                status = EXIT_FAILURE;
+            }
+            client.flush();
+            sendAll(fd, "exit " + std::to_string(status) + "\n");
+            return;
+        } else if (line == "stop") {
+            stopRequested = true;
+            sendAll(fd, "exit 0\n");
+            return;
+        } else {
+            return;
+        }
+    }
+}
+
+int pl0cc::requestCompile(const std::string& socketPath, const CompileRequest& request, std::ostream& log) {
+    return exchange(socketPath, encodeRequest(request, "compile"), log);
+}
+
+void pl0cc::requestStop(const std::string& socketPath) {
+    std::ostream discard(nullptr);
+    exchange(socketPath, encodeRequest(CompileRequest(), "stop"), discard);
+}
+
+std::string pl0cc::defaultDaemonSocket() {
+    const char* runtimeDirectory = std::getenv("XDG_RUNTIME_DIR");
+    if (runtimeDirectory != nullptr && runtimeDirectory[0] == '/') return std::string(runtimeDirectory) + "/pl0cc.sock";
+    std::string directory = "/tmp/pl0cc-" + std::to_string(::getuid());
+    makePrivateDirectory(directory);
+    return directory + "/daemon.sock";
+}
@@ -0,0 +1,68 @@
+#ifndef PL0CC_COMPILE_DAEMON_HPP
+#define PL0CC_COMPILE_DAEMON_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace pl0cc {
+    struct CompileRequest {
+        std::vector<std::string> flags;     // Command line options without the leading "--"
+        std::vector<std::string> inputs;    // Absolute paths, as the daemon may run elsewhere
+        std::vector<std::string> outputs;   // Same length as inputs; empty for --syntax-only
+    };
+
+    /*
+     * Serves compile requests on a Unix domain socket, one request per connection and one thread
+     * per connection, so that the handler can keep its tables and worker pool warm between requests.
+     * The socket is only open to its owner, and connections from other users are dropped unanswered.
+     *
+     * Wire format, all lines ending in '\n':
+     *   request   "pl0cc 1", then "flag <name>", "file <input>\t<output>" lines, then "compile" or "stop"
+     *   response  any number of "log <n>" lines each followed by n bytes of diagnostics, then "exit <status>"
+     */
+    class CompileDaemon {
+    public:
+        // Writes diagnostics to client as they become ready and returns the exit status
+        using Handler = std::function<int(const CompileRequest& request, std::ostream& client)>;
+
+        // Throws std::runtime_error if the socket cannot be created or another daemon is listening
+        CompileDaemon(std::string socketPath, Handler handler);
+        // Removes the socket file
+        ~CompileDaemon();
+
+        CompileDaemon(const CompileDaemon&) = delete;
+        CompileDaemon& operator=(const CompileDaemon&) = delete;
+
+        // Accepts requests until a stop request, SIGINT or SIGTERM
+        void serve();
+    private:
+        std::string socketPath;
+        Handler handler;
+        int listenFd;
+        std::atomic<bool> stopRequested;
+        std::mutex connectionMutex;
+        std::condition_variable connectionsClosed;
+        size_t openConnections;
+
+        void serveConnection(int fd);
+    };
+
+    // Sends a compile request and copies the streamed diagnostics to log; returns the exit status.
+    // Throws std::runtime_error if no daemon of the current user answers on socketPath.
+    int requestCompile(const std::string& socketPath, const CompileRequest& request, std::ostream& log);
+    void requestStop(const std::string& socketPath);
+
+    /*
+     * Default socket for the current user: in $XDG_RUNTIME_DIR, or else in /tmp/pl0cc-<uid>,
+     * which is created with mode 0700. Throws std::runtime_error if that directory is not
+     * private to the user.
+     */
+    std::string defaultDaemonSocket();
+}
+
+#endif // PL0CC_COMPILE_DAEMON_HPP
@@ -0,0 +1,202 @@
+#include "incremental_parser.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+using namespace pl0cc;
+
+namespace {
+    using Region = IncrementalParser::Region;
+
+    /*
+     * Builds the tree like SyntaxTreeBuilder and records the span of every STMT and FNDEF
+     * from the stream index of each matched token. Binary operators arrive late and without
+     * an index, but no span starts or ends with one.
+     */
+    class RegionRecorder {
+    public:
+        explicit RegionRecorder(std::vector<Region>& regions) :
+            regions(regions), unstarted(0), lastToken(0), rootNode(nullptr) {}
+
+        void enter(Symbol symbol) {
+            SyntaxTree* parent = builder.current();
+            size_t childIndex = parent == nullptr ? 0 : parent->childCount();
+            builder.enter(symbol);
+            if (rootNode == nullptr) rootNode = builder.current();
+
+            if (symbol == symbols::STMT || symbol == symbols::FNDEF) {
+                size_t parentRegion = openRegions.empty() ? IncrementalParser::NO_REGION : openRegions.back();
+                openRegions.push_back(regions.size());
+                regions.push_back(Region{parent, childIndex, parentRegion, 0, 0, TokenType::TOKEN_EOF});
+            }
+        }
+
+        void token(Token token, size_t index) {
+            for (; unstarted < regions.size(); unstarted++) {
+                regions[unstarted].begin = index;
+                regions[unstarted].firstToken = token.type;
+            }
+            lastToken = index;
+            builder.token(token, index);
+        }
+
+        void exit(Symbol symbol) {
+            if (symbol == symbols::STMT || symbol == symbols::FNDEF) {
+                regions[openRegions.back()].end = lastToken + 1;
+                openRegions.pop_back();
+            }
+            builder.exit(symbol);
+        }
+
+        void binary(Token op) {
+            builder.binary(op);
+        }
+
+        std::shared_ptr<SyntaxTree> result() {
+            // The builder moves its root out, so regions directly below it get the new address
+            auto node = std::make_shared<SyntaxTree>(builder.result());
+            for (Region& region : regions) {
+                if (region.parent == rootNode) region.parent = node.get();
+            }
+            return node;
+        }
+    private:
+        std::vector<Region>& regions;
+        std::vector<size_t> openRegions;
+        size_t unstarted, lastToken;
+        SyntaxTreeBuilder builder;
+        SyntaxTree* rootNode;
+    };
+
+    TokenType firstTokenFrom(const TokenStorage& ts, size_t index) {
+        while (ts[index].type == TokenType::NEWLINE) index++;
+        return ts[index].type;
+    }
+
+    // The edit turning the stream before first into the stream after second
+    Lexer::TokenEdit composeEdits(const Lexer::TokenEdit& first, const Lexer::TokenEdit& second) {
+        size_t until = std::max(first.newEnd, second.oldEnd);
+        return Lexer::TokenEdit{
+            std::min(first.from, second.from),
+            until - (first.newEnd - first.oldEnd),
+            until - second.oldEnd + second.newEnd,
+            first.newlinesOnly && second.newlinesOnly
+        };
+    }
+}
+
+IncrementalParser::IncrementalParser(const Syntax& syntax, const LlMap& llMap, const OperatorPrecedenceTable* exprTable) :
+    syntax(syntax), llMap(llMap), exprTable(exprTable), root(), regions(), lastReparsed(0), pending() {}
+
+const SyntaxTree& IncrementalParser::parse(const TokenStorage& ts) {
+    root = nullptr;
+    regions.clear();
+    pending.reset();
+    return parseAll(ts);
+}
+
+const SyntaxTree& IncrementalParser::parseAll(const TokenStorage& ts) {
+    std::vector<Region> fresh;
+    RegionRecorder recorder(fresh);
+    size_t parsed = llZeroParseSymbolEvents(syntax, llMap, syntax.start(), ts, 0, recorder, exprTable);
+
+    root = recorder.result();
+    regions = std::move(fresh);
+    pending.reset();
+    lastReparsed = parsed;
+    return *root;
+}
+
+void IncrementalParser::deferEdit(const Lexer::TokenEdit& edit) {
+    if (root != nullptr) pending = pending ? composeEdits(*pending, edit) : edit;
+}
+
+const SyntaxTree& IncrementalParser::reparse(const TokenStorage& ts, const Lexer::TokenEdit& latest) {
+    if (root == nullptr) return parse(ts);
+    deferEdit(latest);
+    const Lexer::TokenEdit edit = *pending;
+
+    const long tokenDelta = long(edit.newEnd) - long(edit.oldEnd);
+
+    // NEWLINEs never reach the tree and no span starts or ends with one, so only the spans move
+    if (edit.newlinesOnly) {
+        for (Region& region : regions) {
+            if (region.begin >= edit.oldEnd) region.begin = size_t(long(region.begin) + tokenDelta);
+            if (region.end > edit.from) region.end = size_t(long(region.end) + tokenDelta);
+        }
+        pending.reset();
+        lastReparsed = 0;
+        return *root;
+    }
+
+    // The regions containing the edit are the innermost region starting before it and its ancestors
+    auto after = std::upper_bound(
+            regions.begin(), regions.end(), edit.from,
+            [](size_t from, const Region& region) { return from < region.begin; }
+    );
+    size_t index = after == regions.begin() ? NO_REGION : size_t(after - regions.begin()) - 1;
+    for (; index != NO_REGION; index = regions[index].parentRegion) {
+        const Region& region = regions[index];
+        if (edit.from >= region.end || edit.oldEnd > region.end) continue;
+        // The enclosing parse chose this symbol by its first token
+        if (region.begin == edit.from && firstTokenFrom(ts, region.begin) != region.firstToken) continue;
+        if (reparseRegion(index, ts, tokenDelta)) {
+            pending.reset();
+            return *root;
+        }
+    }
+
+    // Keeps the tree and the pending edit if the stream has a syntax error anyway
+    return parseAll(ts);
+}
+
+bool IncrementalParser::reparseRegion(size_t index, const TokenStorage& ts, long tokenDelta) {
+    const Region region = regions[index];
+    const Symbol symbol = region.parent->childAt(region.childIndex).symbol();
+
+    std::vector<Region> fresh;
+    RegionRecorder recorder(fresh);
+    try {
+        llZeroParseSymbolEvents(syntax, llMap, symbol, ts, region.begin, recorder, exprTable);
+    } catch (const std::tuple<int, int, int>&) {
+        return false;
+    }
+    // The following tokens must still be parsed by the enclosing symbols
+    if (long(fresh[0].end) != long(region.end) + tokenDelta) return false;
+
+    region.parent->replaceChild(region.childIndex, recorder.result());
+    lastReparsed = fresh[0].end - region.begin;
+
+    // Replace the regions inside the old subtree
+    size_t oldLast = index + 1;
+    while (oldLast < regions.size() && regions[oldLast].begin < region.end) oldLast++;
+
+    fresh[0].parent = region.parent;
+    fresh[0].childIndex = region.childIndex;
+    fresh[0].parentRegion = region.parentRegion;
+    for (size_t i = 1; i < fresh.size(); i++) fresh[i].parentRegion += index;
+
+    const long countDelta = long(fresh.size()) - long(oldLast - index);
+    if (countDelta == 0) {
+        std::copy(fresh.begin(), fresh.end(), regions.begin() + long(index));
+    } else {
+        regions.erase(regions.begin() + long(index), regions.begin() + long(oldLast));
+        regions.insert(regions.begin() + long(index), fresh.begin(), fresh.end());
+    }
+
+    // Shift the spans after the edit and the parent links past the replaced regions
+    if (tokenDelta != 0 || countDelta != 0) {
+        for (size_t i = index + fresh.size(); i < regions.size(); i++) {
+            Region& r = regions[i];
+            r.begin = size_t(long(r.begin) + tokenDelta);
+            r.end = size_t(long(r.end) + tokenDelta);
+            if (r.parentRegion != NO_REGION && r.parentRegion >= oldLast) {
+                r.parentRegion = size_t(long(r.parentRegion) + countDelta);
+            }
+        }
+    }
+    for (size_t i = region.parentRegion; i != NO_REGION; i = regions[i].parentRegion) {
+        regions[i].end = size_t(long(regions[i].end) + tokenDelta);
+    }
+    return true;
+}
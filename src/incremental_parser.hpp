@@ -0,0 +1,73 @@
+#ifndef PL0CC_INCREMENTAL_PARSER_HPP
+#define PL0CC_INCREMENTAL_PARSER_HPP
+
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "lexer.hpp"
+#include "syntax.hpp"
+
+namespace pl0cc {
+    /*
+     * LL(1) parser that keeps the previous SyntaxTree and the token span of every
+     * STMT and FNDEF in it. After a Lexer::applyEdit(), reparse() takes the innermost
+     * such subtree around the edited tokens whose first token type and following token
+     * are unchanged, parses only that span and replaces the subtree in place. Every other
+     * subtree is kept. If no subtree reparses to exactly the edited span, the whole
+     * token stream is parsed again.
+     *
+     * A reparse() that fails keeps the last tree and composes its edit with the next ones,
+     * so that fixing a syntax error the user typed through reparses just the subtree around
+     * all the edits.
+     *
+     * The syntax, its llMap and the operator table are borrowed and must outlive the parser,
+     * so that many documents can share them.
+     */
+    class IncrementalParser {
+    public:
+        IncrementalParser(const Syntax& syntax, const LlMap& llMap, const OperatorPrecedenceTable* exprTable = nullptr);
+
+        // Both throw like llZeroParseSyntax; after parse() throws, the next reparse() parses everything
+        const SyntaxTree& parse(const TokenStorage& ts);
+        const SyntaxTree& reparse(const TokenStorage& ts, const Lexer::TokenEdit& edit);
+        // Takes an edit into account without parsing, e.g. while the lexer reports errors
+        void deferEdit(const Lexer::TokenEdit& edit);
+
+        [[nodiscard]] bool hasTree() const { return root != nullptr; }
+        // false while edits since the tree was built are pending
+        [[nodiscard]] bool upToDate() const { return root != nullptr && !pending; }
+        // The tree of the last error-free stream
+        [[nodiscard]] const SyntaxTree& tree() const { return *root; }
+        // Tokens covered by the last parse() or reparse()
+        [[nodiscard]] size_t reparsedTokenCount() const { return lastReparsed; }
+
+        static constexpr size_t NO_REGION = std::numeric_limits<size_t>::max();
+
+        // A STMT or FNDEF subtree, found as child childIndex of parent
+        struct Region {
+            SyntaxTree* parent;
+            size_t childIndex;
+            size_t parentRegion;    // NO_REGION at the top level
+            size_t begin, end;      // Token span, NEWLINEs around it excluded
+            TokenType firstToken;
+        };
+        [[nodiscard]] const std::vector<Region>& subtreeSpans() const { return regions; }
+    private:
+        const Syntax& syntax;
+        const LlMap& llMap;
+        const OperatorPrecedenceTable* exprTable;
+        std::shared_ptr<SyntaxTree> root;
+        std::vector<Region> regions;   // Pre-order, so sorted by begin
+        size_t lastReparsed;
+        // Edits since the tree was built, composed into one
+        std::optional<Lexer::TokenEdit> pending;
+
+        // Parses the whole stream into a new tree; leaves every member as it was if that throws
+        const SyntaxTree& parseAll(const TokenStorage& ts);
+        bool reparseRegion(size_t index, const TokenStorage& ts, long tokenDelta);
+    };
+}
+
+#endif // PL0CC_INCREMENTAL_PARSER_HPP
@@ -0,0 +1,253 @@
+#include "input_reader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "memory_report.hpp"
+#include "trace.hpp"
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define PL0CC_HAVE_IO_URING 1
+#endif
+
+using namespace pl0cc;
+
+// Reads one chunk at a time; wait() returns the result of the last submit() like pread()
+class ChunkedFileReader::Backend {
+public:
+    virtual ~Backend() = default;
+    virtual void submit(char* buffer, size_t length, size_t fileOffset) = 0;
+    virtual long wait() = 0;
+    [[nodiscard]] virtual bool ioUring() const = 0;
+};
+
+namespace {
+    class PreadThreadBackend : public ChunkedFileReader::Backend {
+    public:
+        explicit PreadThreadBackend(int fd) : fd(fd), thread([this] { run(); }) {}
+
+        ~PreadThreadBackend() override {
+            {
+                std::lock_guard lock(mutex);
+                stopping = true;
+            }
+            changed.notify_all();
+            thread.join();
+        }
+
+        void submit(char* buffer, size_t length, size_t fileOffset) override {
+            {
+                std::lock_guard lock(mutex);
+                request = {buffer, length, fileOffset};
+                hasRequest = true;
+            }
+            changed.notify_all();
+        }
+
+        long wait() override {
+            std::unique_lock lock(mutex);
+            changed.wait(lock, [this] { return hasResult; });
+            hasResult = false;
+            return result;
+        }
+
+        [[nodiscard]] bool ioUring() const override { return false; }
+    private:
+        struct Request {
+            char* buffer;
+            size_t length, fileOffset;
+        };
+
+        int fd;
+        std::mutex mutex;
+        std::condition_variable changed;
+        Request request {};
+        bool hasRequest = false, hasResult = false, stopping = false;
+        long result = 0;
+        std::thread thread;
+
+        void run() {
+            std::unique_lock lock(mutex);
+            while (true) {
+                changed.wait(lock, [this] { return hasRequest || stopping; });
+                if (stopping) return;
+                Request current = request;
+                hasRequest = false;
+                lock.unlock();
+                long r;
+                do {
+                    r = ::pread(fd, current.buffer, current.length, off_t(current.fileOffset));
+                } while (r < 0 && errno == EINTR);
+                if (r < 0) r = -errno;
+                lock.lock();
+                result = r;
+                hasResult = true;
+                changed.notify_all();
+            }
+        }
+    };
+
+#ifdef PL0CC_HAVE_IO_URING
+    // A two-entry ring driven with the raw system calls; at most one read is in flight
+    class IoUringBackend : public ChunkedFileReader::Backend {
+    public:
+        // Null where io_uring is missing, disabled or too old for IORING_OP_READ
+        static std::unique_ptr<IoUringBackend> open(int fd) {
+            io_uring_params params {};
+            int ringFd = int(::syscall(__NR_io_uring_setup, 2, &params));
+            if (ringFd < 0) return nullptr;
+            // Kernels with FAST_POLL (5.7) know IORING_OP_READ and map both rings at once
+            unsigned needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_FAST_POLL;
+            if ((params.features & needed) != needed) {
+                ::close(ringFd);
+                return nullptr;
+            }
+            std::unique_ptr<IoUringBackend> backend(new IoUringBackend(fd, ringFd));
+            if (!backend->map(params)) return nullptr;
+            return backend;
+        }
+
+        ~IoUringBackend() override {
+            if (sqes != MAP_FAILED) ::munmap(sqes, sqesSize);
+            if (rings != MAP_FAILED) ::munmap(rings, ringsSize);
+            ::close(ringFd);
+        }
+
+        void submit(char* buffer, size_t length, size_t fileOffset) override {
+            unsigned tail = *sqTail;
+            unsigned index = tail & *sqMask;
+            io_uring_sqe& sqe = sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = fd;
+            sqe.addr = std::uint64_t(reinterpret_cast<std::uintptr_t>(buffer));
+            sqe.len = unsigned(length);
+            sqe.off = fileOffset;
+            sqArray[index] = index;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+            submitError = 0;
+            while (enter(1, 0, 0) < 0) {
+                if (errno == EINTR) continue;
+                submitError = -errno;
+                break;
+            }
+        }
+
+        long wait() override {
+            if (submitError != 0) return submitError;
+            while (true) {
+                unsigned head = *cqHead;
+                if (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                    long r = cqes[head & *cqMask].res;
+                    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+                    return r;
+                }
+                if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) return -errno;
+            }
+        }
+
+        [[nodiscard]] bool ioUring() const override { return true; }
+    private:
+        int fd, ringFd;
+        void* rings = MAP_FAILED;
+        size_t ringsSize = 0;
+        io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        size_t sqesSize = 0;
+        unsigned *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+        unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+        io_uring_cqe* cqes = nullptr;
+        long submitError = 0;
+
+        IoUringBackend(int fd, int ringFd) : fd(fd), ringFd(ringFd) {}
+
+        bool map(const io_uring_params& params) {
+            ringsSize = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                 params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+            rings = ::mmap(nullptr, ringsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+            if (rings == MAP_FAILED) return false;
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            void* mappedSqes = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+            if (mappedSqes == MAP_FAILED) return false;
+            sqes = static_cast<io_uring_sqe*>(mappedSqes);
+            auto* base = static_cast<char*>(rings);
+            sqTail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+            sqMask = reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+            cqHead = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+            cqMask = reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+            return true;
+        }
+
+        int enter(unsigned toSubmit, unsigned minComplete, unsigned flags) const {
+            return int(::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+        }
+    };
+#endif
+}
+
+ChunkedFileReader::ChunkedFileReader(const std::string& filename, size_t chunkSize, bool allowIoUring) :
+    filename(filename), fd(::open(filename.c_str(), O_RDONLY | O_CLOEXEC)), reading(-1), offset(0) {
+    if (fd < 0) throw std::runtime_error("Cannot open " + filename);
+#ifdef PL0CC_HAVE_IO_URING
+    if (allowIoUring) backend = IoUringBackend::open(fd);
+#endif
+    if (!backend) backend = std::make_unique<PreadThreadBackend>(fd);
+    for (std::vector<char>& buffer : buffers) buffer.resize(std::max<size_t>(chunkSize, 1));
+    reading = 0;
+    backend->submit(buffers[0].data(), buffers[0].size(), 0);
+}
+
+ChunkedFileReader::~ChunkedFileReader() {
+    // The kernel or the reader thread may still write to a buffer
+    if (reading >= 0) backend->wait();
+    backend.reset();
+    ::close(fd);
+}
+
+std::string_view ChunkedFileReader::next() {
+    if (reading < 0) return {};
+    int done = reading;
+    long r = backend->wait();
+    if (r <= 0) {
+        reading = -1;
+        if (r < 0) throw std::runtime_error("Cannot read " + filename + ": " + std::strerror(int(-r)));
+        return {};
+    }
+    offset += size_t(r);
+    reading = 1 - done;
+    backend->submit(buffers[reading].data(), buffers[reading].size(), offset);
+    return {buffers[done].data(), size_t(r)};
+}
+
+bool ChunkedFileReader::usesIoUring() const {
+    return backend->ioUring();
+}
+
+void pl0cc::lexChunks(Lexer& lexer, ChunkedFileReader& reader, TimeReport* report) {
+    PL0CC_TRACE_SCOPE("lex");
+    memory::PhaseScope lexPhase(memory::Phase::LEX);
+    while (true) {
+        TimeReport::Timer readTimer(report, TimeReport::Phase::READ);
+        std::string_view chunk = reader.next();
+        readTimer.stop();
+        if (chunk.empty()) break;
+        TimeReport::Timer lexTimer(report, TimeReport::Phase::LEX);
+        for (char c : chunk) lexer.feedChar(c);
+    }
+    TimeReport::Timer lexTimer(report, TimeReport::Phase::LEX);
+    lexer.eof();
+}
@@ -0,0 +1,61 @@
+#ifndef PL0CC_INPUT_READER_HPP
+#define PL0CC_INPUT_READER_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lexer.hpp"
+#include "time_report.hpp"
+
+namespace pl0cc {
+    /*
+     * Reads a file front to back in chunks through two buffers: while the caller works on one
+     * chunk, the next one is already being read into the other buffer. The reads go through
+     * io_uring where the kernel allows it and through a reader thread calling pread() otherwise.
+     */
+    class ChunkedFileReader {
+    public:
+        static constexpr size_t DEFAULT_CHUNK_SIZE = size_t(256) << 10;
+
+        // Throws std::runtime_error if filename cannot be opened
+        explicit ChunkedFileReader(const std::string& filename, size_t chunkSize = DEFAULT_CHUNK_SIZE,
+                                   bool allowIoUring = true);
+        ~ChunkedFileReader();
+
+        ChunkedFileReader(const ChunkedFileReader&) = delete;
+        ChunkedFileReader& operator=(const ChunkedFileReader&) = delete;
+
+        /*
+         * The next chunk, valid until the following call; empty at the end of the file.
+         * Throws std::runtime_error if a read fails.
+         */
+        std::string_view next();
+
+        [[nodiscard]] bool usesIoUring() const;
+        [[nodiscard]] size_t bytesRead() const { return offset; }
+
+        // The io_uring or pread() thread reads, defined in input_reader.cpp
+        class Backend;
+    private:
+        std::string filename;
+        int fd;
+        std::unique_ptr<Backend> backend;
+        std::vector<char> buffers[2];
+        int reading;        // Buffer of the read in flight, or -1
+        size_t offset;      // File offset of the read in flight
+    };
+
+    /*
+     * Feeds every chunk of reader to lexer, then eof(). Chunks go straight from the read
+     * buffers into the lexer, which carries a token that straddles two chunks in its own state.
+     * The lexer still appends every byte to its source unless lexer.discardSource() was called;
+     * its diagnostic lines and the token tables grow with the file either way.
+     * Waiting for a chunk counts as READ time, the rest as LEX time.
+     */
+    void lexChunks(Lexer& lexer, ChunkedFileReader& reader, TimeReport* report = nullptr);
+}
+
+#endif // PL0CC_INPUT_READER_HPP
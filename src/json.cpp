@@ -0,0 +1,307 @@
+#include "json.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+using namespace pl0cc;
+
+namespace {
+    class JsonParser {
+    public:
+        explicit JsonParser(std::string_view text) : text(text), pos(0) {}
+
+        JsonValue parseDocument() {
+            JsonValue value = parseValue();
+            skipSpaces();
+            if (pos != text.size()) fail("trailing characters");
+            return value;
+        }
+    private:
+        std::string_view text;
+        size_t pos;
+
+        [[noreturn]] void fail(const char* what) const {
+            throw std::runtime_error("JSON parse error at " + std::to_string(pos) + ": " + what);
+        }
+
+        void skipSpaces() {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) {
+                pos++;
+            }
+        }
+
+        bool consume(std::string_view word) {
+            if (text.substr(pos, word.size()) != word) return false;
+            pos += word.size();
+            return true;
+        }
+
+        JsonValue parseValue() {
+            skipSpaces();
+            if (pos >= text.size()) fail("unexpected end");
+            char ch = text[pos];
+            if (ch == '{') return parseObject();
+            if (ch == '[') return parseArray();
+            if (ch == '"') return parseString();
+            if (consume("true")) return true;
+            if (consume("false")) return false;
+            if (consume("null")) return nullptr;
+            if (ch == '-' || (ch >= '0' && ch <= '9')) return parseNumber();
+            fail("unexpected character");
+        }
+
+        JsonValue parseObject() {
+            JsonValue::Object object;
+            pos++;
+            skipSpaces();
+            if (consume("}")) return object;
+            while (true) {
+                skipSpaces();
+                if (pos >= text.size() || text[pos] != '"') fail("expected member name");
+                std::string key = parseString();
+                skipSpaces();
+                if (!consume(":")) fail("expected ':'");
+                object[std::move(key)] = parseValue();
+                skipSpaces();
+                if (consume("}")) return object;
+                if (!consume(",")) fail("expected ',' or '}'");
+            }
+        }
+
+        JsonValue parseArray() {
+            JsonValue::Array array;
+            pos++;
+            skipSpaces();
+            if (consume("]")) return array;
+            while (true) {
+                array.push_back(parseValue());
+                skipSpaces();
+                if (consume("]")) return array;
+                if (!consume(",")) fail("expected ',' or ']'");
+            }
+        }
+
+        JsonValue parseNumber() {
+            size_t start = pos;
+            if (text[pos] == '-') pos++;
+            while (pos < text.size() && (isdigit(text[pos]) || text[pos] == '.' || text[pos] == 'e' ||
+                                         text[pos] == 'E' || text[pos] == '+' || text[pos] == '-')) {
+                pos++;
+            }
+            std::string number(text.substr(start, pos - start));
+            char* end;
+            double value = std::strtod(number.c_str(), &end);
+            if (end != number.c_str() + number.size()) fail("malformed number");
+            return value;
+        }
+
+        unsigned parseHex4() {
+            if (pos + 4 > text.size()) fail("short \\u escape");
+            unsigned value = 0;
+            for (int i = 0; i < 4; i++) {
+                char ch = text[pos++];
+                value <<= 4;
+                if (ch >= '0' && ch <= '9') value |= unsigned(ch - '0');
+                else if (ch >= 'a' && ch <= 'f') value |= unsigned(ch - 'a' + 10);
+                else if (ch >= 'A' && ch <= 'F') value |= unsigned(ch - 'A' + 10);
+                else fail("bad \\u escape");
+            }
+            return value;
+        }
+
+        static void appendUtf8(std::string& out, unsigned codePoint) {
+            if (codePoint < 0x80) {
+                out.push_back(char(codePoint));
+            } else if (codePoint < 0x800) {
+                out.push_back(char(0xC0 | (codePoint >> 6)));
+                out.push_back(char(0x80 | (codePoint & 0x3F)));
+            } else if (codePoint < 0x10000) {
+                out.push_back(char(0xE0 | (codePoint >> 12)));
+                out.push_back(char(0x80 | ((codePoint >> 6) & 0x3F)));
+                out.push_back(char(0x80 | (codePoint & 0x3F)));
+            } else {
+                out.push_back(char(0xF0 | (codePoint >> 18)));
+                out.push_back(char(0x80 | ((codePoint >> 12) & 0x3F)));
+                out.push_back(char(0x80 | ((codePoint >> 6) & 0x3F)));
+                out.push_back(char(0x80 | (codePoint & 0x3F)));
+            }
+        }
+
+        std::string parseString() {
+            std::string out;
+            pos++;
+            while (true) {
+                if (pos >= text.size()) fail("unterminated string");
+                char ch = text[pos++];
+                if (ch == '"') return out;
+                if (ch != '\\') {
+                    out.push_back(ch);
+                    continue;
+                }
+                if (pos >= text.size()) fail("unterminated string");
+                switch (text[pos++]) {
+                    case '"': out.push_back('"'); break;
+                    case '\\': out.push_back('\\'); break;
+                    case '/': out.push_back('/'); break;
+                    case 'b': out.push_back('\b'); break;
+                    case 'f': out.push_back('\f'); break;
+                    case 'n': out.push_back('\n'); break;
+                    case 'r': out.push_back('\r'); break;
+                    case 't': out.push_back('\t'); break;
+                    case 'u': {
+                        unsigned codePoint = parseHex4();
+                        // Surrogate pair
+                        if (codePoint >= 0xD800 && codePoint < 0xDC00 && consume("\\u")) {
+                            unsigned low = parseHex4();
+                            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        appendUtf8(out, codePoint);
+                        break;
+                    }
+                    default:
+                        fail("bad escape");
+                }
+            }
+        }
+    };
+
+    void writeString(std::ostream& os, const std::string& str) {
+        os << '"';
+        for (char ch : str) {
+            switch (ch) {
+                case '"': os << "\\\""; break;
+                case '\\': os << "\\\\"; break;
+                case '\b': os << "\\b"; break;
+                case '\f': os << "\\f"; break;
+                case '\n': os << "\\n"; break;
+                case '\r': os << "\\r"; break;
+                case '\t': os << "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(ch) < 0x20) {
+                        char escape[8];
+                        std::snprintf(escape, sizeof escape, "\\u%04x", ch);
+                        os << escape;
+                    } else {
+                        os << ch;
+                    }
+            }
+        }
+        os << '"';
+    }
+
+    const JsonValue nullValue;
+}
+
+bool JsonValue::asBool() const {
+    if (type() != Type::BOOLEAN) throw std::runtime_error("JSON value is not a boolean");
+    return std::get<bool>(data);
+}
+
+double JsonValue::asNumber() const {
+    if (type() != Type::NUMBER) throw std::runtime_error("JSON value is not a number");
+    return std::get<double>(data);
+}
+
+const std::string& JsonValue::asString() const {
+    if (type() != Type::STRING) throw std::runtime_error("JSON value is not a string");
+    return std::get<std::string>(data);
+}
+
+const JsonValue::Array& JsonValue::asArray() const {
+    if (type() != Type::ARRAY) throw std::runtime_error("JSON value is not an array");
+    return std::get<Array>(data);
+}
+
+JsonValue::Array& JsonValue::asArray() {
+    if (type() != Type::ARRAY) throw std::runtime_error("JSON value is not an array");
+    return std::get<Array>(data);
+}
+
+const JsonValue::Object& JsonValue::asObject() const {
+    if (type() != Type::OBJECT) throw std::runtime_error("JSON value is not an object");
+    return std::get<Object>(data);
+}
+
+JsonValue::Object& JsonValue::asObject() {
+    if (type() != Type::OBJECT) throw std::runtime_error("JSON value is not an object");
+    return std::get<Object>(data);
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const {
+    if (type() != Type::OBJECT) return nullValue;
+    const Object& object = std::get<Object>(data);
+    auto it = object.find(key);
+    return it == object.end() ? nullValue : it->second;
+}
+
+JsonValue& JsonValue::operator[](const std::string& key) {
+    if (isNull()) data = Object();
+    return asObject()[key];
+}
+
+bool JsonValue::contains(const std::string& key) const {
+    return type() == Type::OBJECT && std::get<Object>(data).count(key);
+}
+
+JsonValue JsonValue::parse(std::string_view text) {
+    return JsonParser(text).parseDocument();
+}
+
+void JsonValue::serializeTo(std::ostream& os) const {
+    switch (type()) {
+        case Type::NUL:
+            os << "null";
+            break;
+        case Type::BOOLEAN:
+            os << (std::get<bool>(data) ? "true" : "false");
+            break;
+        case Type::NUMBER: {
+            double value = std::get<double>(data);
+            if (std::nearbyint(value) == value && std::fabs(value) < 9007199254740992.0) {
+                os << (long long)(value);
+            } else {
+                char buffer[32];
+                std::snprintf(buffer, sizeof buffer, "%.17g", value);
+                os << buffer;
+            }
+            break;
+        }
+        case Type::STRING:
+            writeString(os, std::get<std::string>(data));
+            break;
+        case Type::ARRAY: {
+            os << '[';
+            bool first = true;
+            for (const JsonValue& item : std::get<Array>(data)) {
+                if (!first) os << ',';
+                first = false;
+                item.serializeTo(os);
+            }
+            os << ']';
+            break;
+        }
+        case Type::OBJECT: {
+            os << '{';
+            bool first = true;
+            for (const auto& [key, value] : std::get<Object>(data)) {
+                if (!first) os << ',';
+                first = false;
+                writeString(os, key);
+                os << ':';
+                value.serializeTo(os);
+            }
+            os << '}';
+            break;
+        }
+    }
+}
+
+std::string JsonValue::serialize() const {
+    std::ostringstream ss;
+    serializeTo(ss);
+    return ss.str();
+}
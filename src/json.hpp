@@ -0,0 +1,66 @@
+#ifndef PL0CC_JSON_HPP
+#define PL0CC_JSON_HPP
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace pl0cc {
+    /*
+     * Minimal JSON document model for the language server.
+     * Numbers are stored as double and written without a fraction when they are integral.
+     */
+    class JsonValue {
+    public:
+        using Array = std::vector<JsonValue>;
+        using Object = std::map<std::string, JsonValue>;
+
+        enum class Type {
+            NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT
+        };
+
+        JsonValue() : data(nullptr) {}
+        JsonValue(std::nullptr_t) : data(nullptr) {}
+        JsonValue(bool value) : data(value) {}
+        template <typename T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, int> = 0>
+        JsonValue(T value) : data(double(value)) {}
+        JsonValue(const char* value) : data(std::string(value)) {}
+        JsonValue(std::string value) : data(std::move(value)) {}
+        JsonValue(std::string_view value) : data(std::string(value)) {}
+        JsonValue(Array value) : data(std::move(value)) {}
+        JsonValue(Object value) : data(std::move(value)) {}
+
+        [[nodiscard]] Type type() const { return Type(data.index()); }
+        [[nodiscard]] bool isNull() const { return type() == Type::NUL; }
+
+        // These throw std::runtime_error when the value has another type
+        [[nodiscard]] bool asBool() const;
+        [[nodiscard]] double asNumber() const;
+        [[nodiscard]] const std::string& asString() const;
+        [[nodiscard]] const Array& asArray() const;
+        Array& asArray();
+        [[nodiscard]] const Object& asObject() const;
+        Object& asObject();
+
+        // Member lookup; a missing member, or any non-object, reads as null
+        const JsonValue& operator[](const std::string& key) const;
+        // Turns a null value into an object first
+        JsonValue& operator[](const std::string& key);
+        [[nodiscard]] bool contains(const std::string& key) const;
+
+        // Throws std::runtime_error on malformed input
+        static JsonValue parse(std::string_view text);
+
+        void serializeTo(std::ostream& os) const;
+        [[nodiscard]] std::string serialize() const;
+    private:
+        std::variant<std::nullptr_t, bool, double, std::string, Array, Object> data;
+    };
+}
+
+#endif // PL0CC_JSON_HPP
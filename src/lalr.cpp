@@ -0,0 +1,219 @@
+#include "lalr.hpp"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+
+using namespace pl0cc;
+
+namespace {
+    struct Item {
+        uint32_t conduct;
+        uint32_t dot;
+
+        bool operator<(const Item& i2) const {
+            return std::tie(conduct, dot) < std::tie(i2.conduct, i2.dot);
+        }
+        bool operator==(const Item& i2) const {
+            return conduct == i2.conduct && dot == i2.dot;
+        }
+    };
+
+    using Kernel = std::vector<Item>;
+    using Lookaheads = std::map<Item, std::set<Symbol>>;
+}
+
+LalrTable::LalrTable(const Syntax& syntax) :
+    conducts(syntax.conducts()), acceptConduct(0), columnCount(0), _stateCount(0), _conflictCount(0), table()
+{
+    const auto& ntSymbols = syntax.nonTerminatingSymbols();
+    const Symbol endSymbol = Symbol(TokenType::TOKEN_EOF);
+
+    // Augmented conduct S' -> start, reduced only as ACCEPT
+    acceptConduct = uint32_t(conducts.size());
+    conducts.emplace_back(EPS, Sentence{syntax.start()});
+
+    columnCount = size_t(std::max(*syntax.symbols().rbegin(), endSymbol)) + 1;
+
+    std::map<Symbol, std::vector<uint32_t>> conductsOf;
+    for (uint32_t c = 0; c < acceptConduct; c++) {
+        conductsOf[conducts[c].first].push_back(c);
+    }
+
+    auto symbolAfterDot = [&](const Item& item) -> Symbol {
+        const Sentence& rightPart = conducts[item.conduct].second;
+        return item.dot < rightPart.size() ? rightPart[item.dot] : EPS;
+    };
+
+    // LR(0) automaton
+    auto closure = [&](const Kernel& kernel) {
+        std::set<Item> items(kernel.begin(), kernel.end());
+        std::vector<Item> searchStack(kernel);
+        while (!searchStack.empty()) {
+            Item item = searchStack.back();
+            searchStack.pop_back();
+
+            Symbol next = symbolAfterDot(item);
+            if (!ntSymbols.count(next)) continue;
+            for (uint32_t c : conductsOf[next]) {
+                if (items.insert(Item{c, 0}).second) searchStack.push_back(Item{c, 0});
+            }
+        }
+        return items;
+    };
+
+    std::vector<Kernel> kernels;
+    std::map<Kernel, State> kernelStates;
+    std::vector<std::map<Symbol, State>> transitions;
+
+    kernels.push_back({Item{acceptConduct, 0}});
+    kernelStates[kernels[0]] = 0;
+    for (State s = 0; s < kernels.size(); s++) {
+        std::map<Symbol, Kernel> nextKernels;
+        for (const Item& item : closure(kernels[s])) {
+            Symbol next = symbolAfterDot(item);
+            if (next != EPS) nextKernels[next].push_back(Item{item.conduct, item.dot + 1});
+        }
+
+        transitions.emplace_back();
+        for (auto& [sym, kernel] : nextKernels) {
+            // Items come out of an ordered set, so kernels are already sorted
+            auto it = kernelStates.find(kernel);
+            State target;
+            if (it == kernelStates.end()) {
+                target = kernelStates[kernel] = State(kernels.size());
+                kernels.push_back(kernel);
+            } else {
+                target = it->second;
+            }
+            transitions[s][sym] = target;
+        }
+    }
+    _stateCount = kernels.size();
+
+    // Propagate LALR(1) lookaheads between kernels until nothing changes
+    std::map<Item, std::set<Symbol>> suffixFirstSets;
+    auto suffixFirst = [&](const Item& item) -> const std::set<Symbol>& {
+        auto it = suffixFirstSets.find(item);
+        if (it != suffixFirstSets.end()) return it->second;
+        return suffixFirstSets[item] = syntax.firstSet(conducts[item.conduct].second.substr(item.dot + 1));
+    };
+
+    std::vector<Lookaheads> kernelLookaheads(_stateCount);
+    kernelLookaheads[0][Item{acceptConduct, 0}] = {endSymbol};
+
+    auto lookaheadClosure = [&](State s) {
+        Lookaheads lookaheads = kernelLookaheads[s];
+        std::vector<Item> searchStack;
+        for (const auto& [item, _] : lookaheads) searchStack.push_back(item);
+
+        while (!searchStack.empty()) {
+            Item item = searchStack.back();
+            searchStack.pop_back();
+
+            Symbol next = symbolAfterDot(item);
+            if (!ntSymbols.count(next)) continue;
+
+            std::set<Symbol> follow = suffixFirst(item);
+            if (follow.count(EPS)) {
+                follow.erase(EPS);
+                const std::set<Symbol>& inherited = lookaheads[item];
+                follow.insert(inherited.begin(), inherited.end());
+            }
+
+            for (uint32_t c : conductsOf[next]) {
+                Item subItem{c, 0};
+                bool fresh = !lookaheads.count(subItem);
+                std::set<Symbol>& target = lookaheads[subItem];
+                size_t oldSize = target.size();
+                target.insert(follow.begin(), follow.end());
+                if (fresh || target.size() != oldSize) searchStack.push_back(subItem);
+            }
+        }
+        return lookaheads;
+    };
+
+    bool changed;
+    do {
+        changed = false;
+        for (State s = 0; s < _stateCount; s++) {
+            for (const auto& [item, symbols] : lookaheadClosure(s)) {
+                Symbol next = symbolAfterDot(item);
+                if (next == EPS) continue;
+
+                std::set<Symbol>& target = kernelLookaheads[transitions[s].at(next)][Item{item.conduct, item.dot + 1}];
+                size_t oldSize = target.size();
+                target.insert(symbols.begin(), symbols.end());
+                changed |= target.size() != oldSize;
+            }
+        }
+    } while (changed);
+
+    // Fill the table: shifts and gotos first, then reductions
+    table.assign(_stateCount * columnCount, 0);
+    for (State s = 0; s < _stateCount; s++) {
+        int32_t* row = &table[s * columnCount];
+        for (auto [sym, target] : transitions[s]) {
+            row[sym] = int32_t(target) + 1;
+        }
+
+        for (const auto& [item, symbols] : lookaheadClosure(s)) {
+            if (symbolAfterDot(item) != EPS) continue;
+
+            int32_t reduce = -int32_t(item.conduct) - 1;
+            for (Symbol sym : symbols) {
+                if (row[sym] == 0) {
+                    row[sym] = reduce;
+                    continue;
+                }
+                _conflictCount++;
+                // Keep the shift, or the reduction of the conduct added first
+                if (row[sym] < 0) row[sym] = std::max(row[sym], reduce);
+            }
+        }
+    }
+}
+
+SyntaxTree pl0cc::lalrParseSyntax(const LalrTable& table, const TokenStorage& ts) {
+    using ActionType = LalrTable::ActionType;
+
+    std::vector<LalrTable::State> stateStack{0};
+    std::vector<std::shared_ptr<SyntaxTree>> valueStack;
+
+    auto tokenIter = ts.begin();
+    int lineCounter = 0;
+    int tokenCounter = 0;
+    while (true) {
+        while (tokenIter->type == TokenType::NEWLINE) {
+            tokenIter++;
+            lineCounter++;
+            tokenCounter = 0;
+        }
+
+        LalrTable::Action action = table.action(stateStack.back(), Symbol(tokenIter->type));
+        if (action.type == ActionType::SHIFT) {
+            valueStack.push_back(std::make_shared<SyntaxTree>(*tokenIter++));
+            stateStack.push_back(action.value);
+            tokenCounter++;
+        } else if (action.type == ActionType::REDUCE) {
+            const auto& [conductLeft, conductRight] = table.conduct(action.value);
+            auto node = std::make_shared<SyntaxTree>(conductLeft);
+            for (size_t i = valueStack.size() - conductRight.size(); i < valueStack.size(); i++) {
+                node->addChild(std::move(valueStack[i]));
+            }
+            valueStack.resize(valueStack.size() - conductRight.size());
+            stateStack.resize(stateStack.size() - conductRight.size());
+
+            valueStack.push_back(std::move(node));
+            stateStack.push_back(table.gotoState(stateStack.back(), conductLeft));
+        } else if (action.type == ActionType::ACCEPT) {
+            break;
+        } else {
+            throw std::tuple<int, int, int>(tokenIter - ts.begin(), lineCounter, tokenCounter);
+        }
+    }
+
+    return std::move(*valueStack.back());
+}
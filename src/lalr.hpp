@@ -0,0 +1,64 @@
+#ifndef PL0CC_LALR_HPP
+#define PL0CC_LALR_HPP
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "lexer.hpp"
+#include "syntax.hpp"
+
+namespace pl0cc {
+    /*
+     * LALR(1) parse table generated from the conducts of a Syntax.
+     * Shift/reduce conflicts are resolved by shifting (the dangling else),
+     * reduce/reduce conflicts by the conduct added first.
+     */
+    class LalrTable {
+    public:
+        using State = uint32_t;
+
+        enum class ActionType {
+            ERROR, SHIFT, REDUCE, ACCEPT
+        };
+
+        struct Action {
+            ActionType type;
+            uint32_t value;     // Target state of SHIFT or conduct index of REDUCE
+        };
+
+        explicit LalrTable(const Syntax& syntax);
+
+        [[nodiscard]] size_t stateCount() const { return _stateCount; }
+        [[nodiscard]] size_t conflictCount() const { return _conflictCount; }
+
+        [[nodiscard]] Action action(State state, Symbol terminal) const {
+            if (terminal >= columnCount) return {ActionType::ERROR, 0};
+            int32_t cell = table[state * columnCount + terminal];
+            if (cell > 0) return {ActionType::SHIFT, uint32_t(cell - 1)};
+            if (cell == 0) return {ActionType::ERROR, 0};
+            if (uint32_t(-cell - 1) == acceptConduct) return {ActionType::ACCEPT, 0};
+            return {ActionType::REDUCE, uint32_t(-cell - 1)};
+        }
+
+        [[nodiscard]] State gotoState(State state, Symbol nonTerminating) const {
+            return State(table[state * columnCount + nonTerminating] - 1);
+        }
+
+        [[nodiscard]] const std::pair<Symbol, Sentence>& conduct(size_t index) const { return conducts[index]; }
+    private:
+        std::vector<std::pair<Symbol, Sentence>> conducts;
+        uint32_t acceptConduct;
+        size_t columnCount;
+        size_t _stateCount;
+        size_t _conflictCount;
+
+        // Row per state: positive is shift/goto target + 1, negative is -(conduct index + 1)
+        std::vector<int32_t> table;
+    };
+
+    // If exception throws token count, like llZeroParseSyntax
+    SyntaxTree lalrParseSyntax(const LalrTable& table, const TokenStorage& ts);
+}
+
+#endif // PL0CC_LALR_HPP
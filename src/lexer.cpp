@@ -2,10 +2,15 @@
 #include "deterministic_automaton.hpp"
 #include "nondeterministic_automaton.hpp"
 #include "regex.hpp"
+#include "trace.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
 #include <string>
 #include <sstream>
+#include <cstdint>
 #include <cstring>
 #include <utility>
 #include <mutex>
@@ -69,14 +74,64 @@ namespace pl0cc {
             "ARROW"
     };
 
-    std::unique_ptr<const DeterministicAutomaton> Lexer::automaton = nullptr;
-    static std::mutex buildLock;
+    constexpr int FIRST_KEYWORD = int(TokenType::FN), LAST_KEYWORD = int(TokenType::CHAR);
+    constexpr size_t KEYWORD_COUNT = LAST_KEYWORD - FIRST_KEYWORD + 1;
+
+    /*
+     * Minimal perfect hash over the keywords for KeywordMatching::PERFECT_HASH: every keyword
+     * lands in its own one of KEYWORD_COUNT slots under FNV-1a started from seed. The seed is
+     * searched at compile time, so the table follows tokenRegexs.
+     */
+    struct KeywordHash {
+        std::uint32_t seed = 0;
+        TokenType slots[KEYWORD_COUNT] {};
+        size_t minLength = 0, maxLength = 0;
+
+        [[nodiscard]] constexpr size_t slotOf(std::string_view word) const {
+            std::uint32_t h = seed;
+            for (char c : word) h = (h ^ std::uint8_t(c)) * 16777619u;
+            return h % KEYWORD_COUNT;
+        }
+    };
 
-    void Lexer::buildAutomaton() {
-        using SingleState = NondeterministicAutomaton::SingleState;
+    constexpr KeywordHash findKeywordHash() {
+        KeywordHash hash;
+        hash.minLength = std::string_view(tokenRegexs[FIRST_KEYWORD]).size();
+        for (int type = FIRST_KEYWORD; type <= LAST_KEYWORD; type++) {
+            hash.minLength = std::min(hash.minLength, std::string_view(tokenRegexs[type]).size());
+            hash.maxLength = std::max(hash.maxLength, std::string_view(tokenRegexs[type]).size());
+        }
+        for (hash.seed = 1; hash.seed != 0; hash.seed++) {
+            bool taken[KEYWORD_COUNT] {};
+            bool perfect = true;
+            for (int type = FIRST_KEYWORD; perfect && type <= LAST_KEYWORD; type++) {
+                size_t slot = hash.slotOf(tokenRegexs[type]);
+                perfect = !taken[slot];
+                taken[slot] = true;
+                hash.slots[slot] = TokenType(type);
+            }
+            if (perfect) break;
+        }
+        return hash;
+    }
+
+    constexpr KeywordHash keywordHash = findKeywordHash();
+    static_assert(keywordHash.seed != 0, "no perfect hash seed for the keywords");
+
+    // The keyword whose bytes word are, or SYMBOL
+    static TokenType classifySymbol(std::string_view word) {
+        if (word.size() < keywordHash.minLength || word.size() > keywordHash.maxLength) return TokenType::SYMBOL;
+        TokenType type = keywordHash.slots[keywordHash.slotOf(word)];
+        return word == tokenRegexs[int(type)] ? type : TokenType::SYMBOL;
+    }
+
+    Lexer::Automaton Lexer::automata[2];
+    // Guard the only writes to automata; every later read sees them fully built
+    static std::once_flag automatonBuilt[2];
 
-        std::lock_guard _lockGuard(buildLock);
-        if (automaton != nullptr) return;
+    void Lexer::buildAutomaton(KeywordMatching keywordMatching) {
+        PL0CC_TRACE_SCOPE("build_automaton");
+        using SingleState = NondeterministicAutomaton::SingleState;
 
         NondeterministicAutomaton nfa;
         auto start = nfa.startSingleState();
@@ -88,6 +143,10 @@ namespace pl0cc {
             if (/*strlen(tokenRegexs[type]) == 0*/ tokenRegexs[type][0] == '\0') {
                 continue;
             }
+            // Hashed keywords are scanned as SYMBOLs
+            if (keywordMatching == KeywordMatching::PERFECT_HASH && type >= FIRST_KEYWORD && type <= LAST_KEYWORD) {
+                continue;
+            }
             auto subAtm = automatonFromRegexString(tokenRegexs[type]);
             /*
              * Mark end nodes with 2*type+1 and mark non-end nodes with 2*type,
@@ -102,18 +161,47 @@ namespace pl0cc {
 
         auto dfa = std::make_unique<DeterministicAutomaton>(nfa.toDeterministic());
         dfa->removeStateMarkup(dfa->startState());
-        automaton = std::move(dfa);
+        Automaton& built = automata[int(keywordMatching)];
+        // States where generateTokenAndReset() would emit a token
+        built.acceptingStates.assign(dfa->stateCount(), false);
+        for (DeterministicAutomaton::State s = 0; s < dfa->stateCount(); s++) {
+            const std::set<int>& marks = dfa->stateMarkup(s);
+            built.acceptingStates[s] = dfa->isStopState(s) && std::any_of(marks.begin(), marks.end(), [](int m) { return m & 1; });
+        }
+        built.dfa = std::move(dfa);
     }
 
-    Lexer::Lexer() :
+    Lexer::Lexer(KeywordMatching keywordMatching) :
+        keywords(keywordMatching),
+        automaton(&getDFA(keywordMatching)),
+        acceptingStates(&automata[int(keywordMatching)].acceptingStates),
+        scanned(0), speculating(false), acceptSnapshot(), failedSteps(), failedBase(0), failedLimit(0),
         storage(),
         lineCounter(0), columnCounter(0),
-        hasStopped(false),
+        hasStopped(false), keepingSource(true),
         //commentState(CommentState::NONE),
-        storedLines(1, ""), errors()
+        storedLines(1, ""), errors(),
+        sourceBase(0), tokenBase(0), lineBase(0), errorBase(0)
     {
-        if (automaton == nullptr) buildAutomaton();
         state = automaton->startState();
+        storage.attachSource(&source);
+        recordCheckpoint(0);
+    }
+
+    // Replaces target[from, to) with items, moving the tail at most once
+    template <typename T>
+    static void replaceRange(std::vector<T>& target, size_t from, size_t to, std::vector<T>& items) {
+        size_t common = std::min(to - from, items.size());
+        std::move(items.begin(), items.begin() + long(common), target.begin() + long(from));
+        if (items.size() > common) {
+            target.insert(
+                    target.begin() + long(from + common),
+                    std::make_move_iterator(items.begin() + long(common)),
+                    std::make_move_iterator(items.end())
+            );
+        } else {
+            target.erase(target.begin() + long(from + common), target.begin() + long(to));
+        }
     }
 
     static std::pair<std::set<int>, std::set<int>> splitMarkup(const std::set<int>& markups) {
@@ -128,7 +216,7 @@ namespace pl0cc {
         return std::make_pair(p0, p1);
     }
 
-    bool Lexer::generateTokenAndReset() {
+    bool Lexer::generateTokenAndReset(size_t tokenEnd) {
         using State = DeterministicAutomaton::State;
         bool tokenGenerated = false;
 
@@ -136,6 +224,7 @@ namespace pl0cc {
         // Make sure there's no error happening: last state should be a stop state and marked with type.
         if (automaton->isStopState(state) && !stopMarks.empty()) {
             TokenType type = TokenType(*stopMarks.begin()); // Take the smallest mark (see token type class id as priority)
+            if (type == TokenType::SYMBOL && keywords == KeywordMatching::PERFECT_HASH) type = classifySymbol(readingToken);
 
             // When NEWLINE token is present, maintain lineCounter, columnCounter and storedLines
             if (type == TokenType::NEWLINE) {
@@ -146,7 +235,7 @@ namespace pl0cc {
 
             // Now add the token we've just read
             if (type != TokenType::COMMENT) {
-                pushToken(type, std::move(readingToken));
+                pushToken(tokenEnd - readingToken.size(), readingToken.size(), type, std::move(readingToken));
                 tokenGenerated = true;
             }
 
@@ -162,14 +251,65 @@ namespace pl0cc {
     }
 
     bool Lexer::feedChar(char ch) {
+        source.push_back(ch);
+        bool tokenGenerated = scanSource();
+        if (!keepingSource) discardScannedSource();
+        return tokenGenerated;
+    }
+
+    void Lexer::discardSource() {
+        keepingSource = false;
+        checkpoints.clear();
+        storage.detachSource();
+    }
+
+    void Lexer::discardScannedSource() {
+        const size_t keepFrom = speculating ? acceptSnapshot.offset : scanned;
+        // Only once half of the buffer can go, so that a long speculation is not moved per byte
+        if ((keepFrom - sourceBase) * 2 < source.size()) return;
+        source.erase(0, keepFrom - sourceBase);
+        sourceBase = keepFrom;
+    }
+
+    bool Lexer::scanSource() {
+        bool tokenGenerated = false;
+        // A backtrack moves scanned back to the end of the last accepted token
+        while (scanned < sourceEnd()) {
+            size_t offset = scanned++;
+            /*
+             * A checkpoint inside a speculative token could not restore its accept, and one up to
+             * where a backtrack looked ahead would miss that earlier tokens depend on later bytes
+             */
+            if (keepingSource && offset > sourceBase && source[offset - sourceBase - 1] == '\n' && !speculating &&
+                offset > failedLimit && (checkpoints.empty() || checkpoints.back().offset < offset)) {
+                recordCheckpoint(offset);
+            }
+            tokenGenerated |= scanChar(offset);
+        }
+        return tokenGenerated;
+    }
+
+    bool Lexer::failedStep(DeterministicAutomaton::State from, size_t offset) const {
+        size_t index = (offset - failedBase) * automaton->stateCount() + from;
+        return offset >= failedBase && index < failedSteps.size() && failedSteps[index];
+    }
+
+    bool Lexer::scanChar(size_t offset) {
         using State = DeterministicAutomaton::State;
 
         bool tokenGenerated = false;
-        State trialState = automaton->nextState(state, ch);
+        const char ch = source[offset - sourceBase];
+        if (!failedSteps.empty() && offset > failedLimit) failedSteps.clear();
+
+        State trialState = failedStep(state, offset) ? DeterministicAutomaton::REJECT : automaton->nextState(state, ch);
 
         // When rejected, a new token shall be generated or there's an error happening
         if (trialState == DeterministicAutomaton::REJECT) {
-            tokenGenerated = generateTokenAndReset();
+            if (speculating) {
+                backtrack(offset);
+                return false;
+            }
+            tokenGenerated = generateTokenAndReset(offset);
             trialState = automaton->nextState(state, ch);
             if (trialState == DeterministicAutomaton::REJECT) {
                 trialState = automaton->startState();
@@ -177,6 +317,17 @@ namespace pl0cc {
             }
         }
 
+        if ((*acceptingStates)[trialState]) {
+            speculating = false;
+        } else if ((*acceptingStates)[state]) {
+            acceptSnapshot = Checkpoint {
+                offset, state, readingToken.size(), tokenBase + storage.size(),
+                lineBase + storedLines.size(), storedLines.back().size(), errorBase + errors.size(),
+                lineCounter, columnCounter
+            };
+            speculating = true;
+        }
+
         columnCounter++;
         // If we read non-grammar unit, the state will stay at the start state
         // And just don't read into token
@@ -201,14 +352,47 @@ namespace pl0cc {
                 storedLines.emplace_back();
 
                 // Add NEWLINE Token
-                pushToken(TokenType::NEWLINE);
+                pushToken(offset, 1, TokenType::NEWLINE);
             }
         }
 
         return tokenGenerated;
     }
 
+    void Lexer::backtrack(size_t rejectOffset) {
+        // Accept snapshots only move forward until the table is cleared
+        if (failedSteps.empty()) failedBase = acceptSnapshot.offset;
+        const size_t stateCount = automaton->stateCount();
+        failedSteps.resize(std::max(failedSteps.size(), (rejectOffset - failedBase + 1) * stateCount));
+        // Every state the scan passed since the accept leads to this reject
+        DeterministicAutomaton::State s = acceptSnapshot.state;
+        for (size_t offset = acceptSnapshot.offset; offset <= rejectOffset; offset++) {
+            failedSteps[(offset - failedBase) * stateCount + s] = true;
+            if (offset < rejectOffset) s = automaton->nextState(s, source[offset - sourceBase]);
+        }
+        failedLimit = std::max(failedLimit, rejectOffset);
+
+        // Take back what the bytes after the accept did; only comment NEWLINEs can have been pushed
+        storage.truncate(acceptSnapshot.tokenIndex - tokenBase);
+        spans.resize(acceptSnapshot.tokenIndex - tokenBase);
+        storedLines.resize(acceptSnapshot.lineCount - lineBase);
+        storedLines.back().resize(acceptSnapshot.lastLineLength);
+        lineCounter = acceptSnapshot.lineCounter;
+        columnCounter = acceptSnapshot.columnCounter;
+
+        // The accepting state now rejects at the snapshot offset and emits its token there
+        state = acceptSnapshot.state;
+        readingToken.resize(acceptSnapshot.readingLength);
+        speculating = false;
+        scanned = acceptSnapshot.offset;
+    }
+
+    size_t Lexer::settledTokenCount() const {
+        return speculating ? acceptSnapshot.tokenIndex - tokenBase : storage.size();
+    }
+
     void Lexer::feedStream(std::istream &stream) {
+        PL0CC_TRACE_SCOPE("lex");
         int c;
         while (c = stream.get(), stream) {
             feedChar(static_cast<char>(c));
@@ -216,6 +400,12 @@ namespace pl0cc {
         eof();
     }
 
+    void Lexer::feedString(std::string_view text) {
+        PL0CC_TRACE_SCOPE("lex");
+        for (char c : text) feedChar(c);
+        eof();
+    }
+
     bool Lexer::tokenEmpty() const {
         return storage.size() == 0;
     }
@@ -225,12 +415,19 @@ namespace pl0cc {
     }
 
     void Lexer::eof() {
+        // The end of input rejects like any other byte would
+        while (speculating) {
+            backtrack(sourceEnd());
+            scanSource();
+        }
+        failedSteps.clear();
+
         auto [procedureMarks, endMarks] = splitMarkup(automaton->stateMarkup(state));
 
         if (endMarks.empty()) {
             pushError(ErrorType::NONSTOP_TOKEN);
         } else {
-            generateTokenAndReset();
+            generateTokenAndReset(sourceEnd());
         }
 
         /*
@@ -239,7 +436,7 @@ namespace pl0cc {
         }
         */
 
-        pushToken(TokenType::TOKEN_EOF);
+        pushToken(sourceEnd(), 0, TokenType::TOKEN_EOF);
         hasStopped = true;
     }
 
@@ -247,6 +444,203 @@ namespace pl0cc {
         return hasStopped;
     }
 
+    void Lexer::recordCheckpoint(size_t offset) {
+        checkpoints.push_back(Checkpoint {
+            offset, state, readingToken.size(), tokenBase + storage.size(),
+            lineBase + storedLines.size(), storedLines.back().size(), errorBase + errors.size(),
+            lineCounter, columnCounter
+        });
+    }
+
+    Lexer::TokenEdit Lexer::applyEdit(size_t offset, size_t removeLength, std::string_view text) {
+        if (!hasStopped) throw std::logic_error("Lexer::applyEdit() requires a stopped lexer");
+        if (!keepingSource) throw std::logic_error("Lexer::applyEdit() requires the source, which discardSource() dropped");
+        if (offset > source.size() || removeLength > source.size() - offset) {
+            throw std::out_of_range("Lexer::applyEdit() range exceeds the source");
+        }
+
+        // Restart from the last checkpoint at or before the edit
+        const size_t restartIndex = size_t(std::upper_bound(
+                checkpoints.begin(), checkpoints.end(), offset,
+                [](size_t off, const Checkpoint& cp) { return off < cp.offset; }
+        ) - checkpoints.begin()) - 1;
+        const Checkpoint restart = checkpoints[restartIndex];
+        // String literals viewed from the source would see the edit
+        storage.detachSource();
+
+        const DeterministicAutomaton::State oldState = state;
+        const std::string oldReadingToken = readingToken;
+        const int oldLineCounter = lineCounter, oldColumnCounter = columnCounter;
+
+        // The relexed part goes into emptied members while the previous stream waits here
+        std::string oldSource;
+        std::vector<Token> oldTokens;
+        std::vector<TokenSpan> oldSpans;
+        std::vector<std::string> oldLines;
+        std::vector<ErrorReport> oldErrors;
+        std::vector<Checkpoint> oldCheckpoints;
+        source.swap(oldSource);
+        storage.swapTokens(oldTokens);
+        spans.swap(oldSpans);
+        storedLines.swap(oldLines);
+        errors.swap(oldErrors);
+        checkpoints.swap(oldCheckpoints);
+
+        sourceBase = restart.offset;
+        tokenBase = restart.tokenIndex;
+        lineBase = restart.lineCount - 1;
+        errorBase = restart.errorCount;
+
+        state = restart.state;
+        readingToken = oldSource.substr(restart.offset - restart.readingLength, restart.readingLength);
+        scanned = restart.offset;
+        speculating = false;
+        failedSteps.clear();
+        failedLimit = 0;
+        lineCounter = restart.lineCounter;
+        columnCounter = restart.columnCounter;
+        storedLines.push_back(oldLines[lineBase].substr(0, restart.lastLineLength));
+        hasStopped = false;
+
+        const size_t editEnd = offset + text.size();
+        const size_t newSize = oldSource.size() - removeLength + text.size();
+        auto newCharAt = [&](size_t newOffset) {
+            if (newOffset < offset) return oldSource[newOffset];
+            if (newOffset < editEnd) return text[newOffset - offset];
+            return oldSource[newOffset - editEnd + offset + removeLength];
+        };
+
+        /*
+         * Replaces the previous stream from the restart point up to the old checkpoint `until`
+         * (or to the end) with the relexed part, then shifts everything after it.
+         */
+        auto splice = [&](size_t until) {
+            const bool converged = until < oldCheckpoints.size();
+            const Checkpoint cut = converged ? oldCheckpoints[until] : Checkpoint {
+                oldSource.size(), state, 0, oldTokens.size(), oldLines.size(), oldLines.back().size(),
+                oldErrors.size(), lineCounter, columnCounter
+            };
+            const long offsetDelta = long(sourceEnd()) - long(cut.offset);
+            const long tokenDelta = long(tokenBase + storage.size()) - long(cut.tokenIndex);
+            const long lineCountDelta = long(lineBase + storedLines.size()) - long(cut.lineCount);
+            const long errorDelta = long(errorBase + errors.size()) - long(cut.errorCount);
+            const long lineLengthDelta = long(storedLines.back().size()) - long(cut.lastLineLength);
+            const int lineDelta = lineCounter - cut.lineCounter;
+            // Columns only move on the line the edit ended in
+            const int columnDelta = columnCounter - cut.columnCounter;
+            auto shiftColumn = [&](int line, int column) {
+                return line == cut.lineCounter ? column + columnDelta : column;
+            };
+
+            // Leave out the tokens at both ends of the relexed span that came out unchanged
+            std::vector<Token> newTokens;
+            storage.swapTokens(newTokens);
+            auto sameToken = [](Token t1, Token t2) { return t1.type == t2.type && t1.seman == t2.seman; };
+            TokenEdit edit {restart.tokenIndex, cut.tokenIndex, tokenBase + newTokens.size(), false};
+            while (edit.from < edit.oldEnd && edit.from < edit.newEnd &&
+                   sameToken(oldTokens[edit.from], newTokens[edit.from - tokenBase])) {
+                edit.from++;
+            }
+            while (edit.oldEnd > edit.from && edit.newEnd > edit.from &&
+                   sameToken(oldTokens[edit.oldEnd - 1], newTokens[edit.newEnd - 1 - tokenBase])) {
+                edit.oldEnd--;
+                edit.newEnd--;
+            }
+            auto isNewline = [](Token t) { return t.type == TokenType::NEWLINE; };
+            edit.newlinesOnly =
+                    std::all_of(oldTokens.begin() + long(edit.from), oldTokens.begin() + long(edit.oldEnd), isNewline) &&
+                    std::all_of(newTokens.begin() + long(edit.from - tokenBase), newTokens.begin() + long(edit.newEnd - tokenBase), isNewline);
+
+            oldSource.replace(restart.offset, cut.offset - restart.offset, source);
+            replaceRange(oldTokens, restart.tokenIndex, cut.tokenIndex, newTokens);
+            replaceRange(oldSpans, restart.tokenIndex, cut.tokenIndex, spans);
+            for (size_t i = tokenBase + spans.size(); offsetDelta != 0 && i < oldSpans.size(); i++) {
+                oldSpans[i].offset = size_t(long(oldSpans[i].offset) + offsetDelta);
+            }
+
+            // The line the edit ended in keeps the rest of its previous content
+            if (converged) storedLines.back().append(oldLines[cut.lineCount - 1], cut.lastLineLength, std::string::npos);
+            replaceRange(oldLines, lineBase, converged ? cut.lineCount : oldLines.size(), storedLines);
+
+            replaceRange(oldErrors, restart.errorCount, cut.errorCount, errors);
+            for (size_t i = errorBase + errors.size(); i < oldErrors.size(); i++) {
+                const ErrorReport& e = oldErrors[i];
+                oldErrors[i] = ErrorReport(this, e.errorType(), e.lineNumber() + lineDelta,
+                                           shiftColumn(e.lineNumber(), e.columnNumber()), e.tokenLength(), e.tokenTypes());
+            }
+
+            replaceRange(oldCheckpoints, restartIndex + 1, until, checkpoints);
+            for (size_t i = restartIndex + 1 + checkpoints.size(); i < oldCheckpoints.size(); i++) {
+                Checkpoint& moved = oldCheckpoints[i];
+                if (moved.lineCount == cut.lineCount) {
+                    moved.lastLineLength = size_t(long(moved.lastLineLength) + lineLengthDelta);
+                }
+                moved.offset = size_t(long(moved.offset) + offsetDelta);
+                moved.tokenIndex = size_t(long(moved.tokenIndex) + tokenDelta);
+                moved.lineCount = size_t(long(moved.lineCount) + lineCountDelta);
+                moved.errorCount = size_t(long(moved.errorCount) + errorDelta);
+                moved.columnCounter = shiftColumn(moved.lineCounter, moved.columnCounter);
+                moved.lineCounter += lineDelta;
+            }
+
+            source.swap(oldSource);
+            storage.swapTokens(oldTokens);
+            spans.swap(oldSpans);
+            storedLines.swap(oldLines);
+            errors.swap(oldErrors);
+            checkpoints.swap(oldCheckpoints);
+            sourceBase = tokenBase = lineBase = errorBase = 0;
+            scanned = sourceEnd();
+
+            if (converged) {
+                speculating = false;
+                state = oldState;
+                readingToken = oldReadingToken;
+                lineCounter = oldLineCounter + lineDelta;
+                columnCounter = shiftColumn(oldLineCounter, oldColumnCounter);
+                hasStopped = true;
+            }
+            return edit;
+        };
+
+        size_t oldCp = restartIndex + 1;
+        for (size_t pos = restart.offset; pos < newSize; pos++) {
+            if (pos >= editEnd && !source.empty() && source.back() == '\n') {
+                size_t oldOffset = pos - editEnd + offset + removeLength;
+                while (oldCp < oldCheckpoints.size() && oldCheckpoints[oldCp].offset < oldOffset) oldCp++;
+
+                bool converged = oldCp < oldCheckpoints.size() &&
+                        oldCheckpoints[oldCp].offset == oldOffset &&
+                        oldCheckpoints[oldCp].state == state &&
+                        oldCheckpoints[oldCp].readingLength == readingToken.size();
+                if (converged) {
+                    converged = oldSource.compare(oldOffset - readingToken.size(), readingToken.size(), readingToken) == 0;
+                }
+                if (converged) return splice(oldCp);
+            }
+            feedChar(newCharAt(pos));
+        }
+
+        eof();
+        return splice(oldCheckpoints.size());
+    }
+
+    const std::string& Lexer::sourceText() const {
+        return source;
+    }
+
+    Lexer::TokenSpan Lexer::tokenSpan(size_t index) const {
+        return spans[index];
+    }
+
+    std::string_view Lexer::tokenSpelling(size_t index) const {
+        return std::string_view(source).substr(spans[index].offset, spans[index].length);
+    }
+
+    size_t Lexer::checkpointCount() const {
+        return checkpoints.size();
+    }
+
     size_t Lexer::errorCount() const {
         return errors.size();
     }
@@ -270,9 +664,9 @@ namespace pl0cc {
         readingToken.clear();
     }
 
-    const DeterministicAutomaton &Lexer::getDFA() {
-        if (automaton == nullptr) buildAutomaton();
-        return *automaton;
+    const DeterministicAutomaton &Lexer::getDFA(KeywordMatching keywordMatching) {
+        std::call_once(automatonBuilt[int(keywordMatching)], buildAutomaton, keywordMatching);
+        return *automata[int(keywordMatching)].dfa;
     }
 
     std::string RawToken::serialize() const {
@@ -320,6 +714,13 @@ namespace pl0cc {
         }
         if (needReset) hintLine << MARK_STOP;
 
+        output << "---------------------" << std::endl;
+        output << lineNumber()+1 << " |\t" << hintLine.str() << std::endl;
+        output << "Reason: " << reason() << std::endl << std::endl;
+    }
+
+    std::string Lexer::ErrorReport::reason() const {
+        const std::string& srcLine = lexer->sourceLine(lineNumber());
         std::string reason;
         if (type == ErrorType::INVALID_CHAR) {
             reason = "Read unknown character '"s
@@ -338,9 +739,6 @@ namespace pl0cc {
         } else if (type == ErrorType::NONSTOP_TOKEN) {
             reason = "Ending token has not stopped";
         }
-
-        output << "---------------------" << std::endl;
-        output << lineNumber()+1 << " |\t" << hintLine.str() << std::endl;
-        output << "Reason: " << reason << std::endl << std::endl;
+        return reason;
     }
 }
\ No newline at end of file
@@ -5,13 +5,19 @@
 #ifndef PL0CC_LEXER_HPP
 #define PL0CC_LEXER_HPP
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <memory>
+#include <string_view>
 #include <utility>
 
 #include "deterministic_automaton.hpp"
+#include "string_pool.hpp"
 
 namespace pl0cc {
+    class OutputBuffer;
+
     enum class TokenType: unsigned int {
         COMMENT   = 0,  FN        = 1,  IF        = 2,  ELSE      = 3,  FOR       = 4,
         WHILE     = 5,
@@ -50,13 +56,44 @@ namespace pl0cc {
         Token(TokenType type, int seman) : type(type), seman(seman) {}
     };
 
+    // Value of a NUMBER literal; an integer literal too large for 64 bits is a REAL
+    struct NumberValue {
+        enum class Kind : std::uint8_t { INTEGER, REAL };
+
+        Kind kind = Kind::INTEGER;
+        std::uint64_t integer = 0;
+        double real = 0;
+
+        static NumberValue parse(std::string_view spelling);
+    };
+
     class TokenStorage {
     public:
         TokenStorage();
+        // Takes a stream and constant tables saved earlier, as the artifact cache does
+        TokenStorage(std::vector<Token> tokens, std::vector<std::string> symbols,
+                     std::vector<std::string> numberConstants, std::vector<std::string> stringConstants);
+
+        // A STRING at sourceOffset of the attached source is interned as a view of it
+        void pushToken(RawToken token, size_t sourceOffset = StringPool::NOT_IN_SOURCE);
+        // The source STRING literals are viewed from; see StringPool
+        void attachSource(const std::string* source) { strings.attachSource(source); }
+        void detachSource() { strings.detachSource(); }
 
-        void pushToken(RawToken token);
+        // Used by incremental lexing: swapped tokens keep their interned seman values
+        void swapTokens(std::vector<Token>& other) { tokens.swap(other); }
+        // Drops the tokens from index count on; their constants stay interned
+        void truncate(size_t count) { tokens.resize(std::min(count, tokens.size()), Token(TokenType::TOKEN_EOF, -1)); }
 
         void serializeTo(std::ostream& ss) const;
+        void serializeTo(OutputBuffer& out) const;
+
+        [[nodiscard]] const std::vector<std::string>& symbolTable() const { return symbols; }
+        // Number constants are pooled by value; the table keeps the first spelling of each
+        [[nodiscard]] const std::vector<std::string>& numberTable() const { return numberConstants; }
+        [[nodiscard]] const std::vector<NumberValue>& numberValueTable() const { return numberValues; }
+        // String constants are pooled by decoded value; spelling() gives the first spelling of each
+        [[nodiscard]] const StringPool& stringPool() const { return strings; }
 
         [[nodiscard]] size_t size() const { return tokens.size(); }
         Token operator[](size_t idx) const { return tokens[idx]; }
@@ -68,8 +105,13 @@ namespace pl0cc {
     private:
         std::vector<Token> tokens;
 
-        std::vector<std::string> symbols, numberConstants, stringConstants;
-        std::map<std::string, int> symbolMap, numberConstantMap, stringConstantMap;
+        std::vector<std::string> symbols, numberConstants;
+        std::vector<NumberValue> numberValues;
+        StringPool strings;
+        std::map<std::string, int> symbolMap;
+        std::map<std::pair<NumberValue::Kind, std::uint64_t>, int> numberConstantMap;
+
+        int internNumber(std::string spelling);
     };
 
     class Lexer {
@@ -88,6 +130,7 @@ namespace pl0cc {
             [[nodiscard]] constexpr int tokenLength() const {return tokenLen;}
             [[nodiscard]] std::set<int> tokenTypes() const {return readingTokenType;}
             void reportErrorTo(std::ostream &output, bool colorful = true);
+            [[nodiscard]] std::string reason() const;
         private:
             Lexer *lexer;
             ErrorType type;
@@ -95,25 +138,88 @@ namespace pl0cc {
             std::set<int> readingTokenType;
         };
 
-        Lexer();
+        /*
+         * Lexer state at the start of a line (right after a '\n'). Restoring one and
+         * feeding the source from `offset` on reproduces the rest of the token stream.
+         * The partial token is the span [offset - readingLength, offset) of the source.
+         */
+        struct Checkpoint {
+            size_t offset;
+            DeterministicAutomaton::State state;
+            size_t readingLength;
+            size_t tokenIndex;
+            size_t lineCount, lastLineLength;
+            size_t errorCount;
+            int lineCounter, columnCounter;
+        };
+
+        // Source bytes of a token; NEWLINE tokens inside comments cover the '\n'
+        struct TokenSpan {
+            size_t offset, length;
+        };
+
+        // Old tokens [from, oldEnd) were replaced by the tokens now at [from, newEnd); unchanged tokens at both ends are left out
+        struct TokenEdit {
+            size_t from, oldEnd, newEnd;
+            bool newlinesOnly;  // Every replaced and inserted token is a NEWLINE
+        };
+
+        // How keywords are told apart from SYMBOLs
+        enum class KeywordMatching {
+            AUTOMATON,      // Each keyword has its own path through the DFA
+            PERFECT_HASH    // The DFA only scans SYMBOLs; a perfect hash over their bytes picks out keywords
+        };
+
+        explicit Lexer(KeywordMatching keywordMatching = KeywordMatching::AUTOMATON);
+
+        // The token storage views string literals in the source
+        Lexer(const Lexer&) = delete;
+        Lexer& operator=(const Lexer&) = delete;
 
         TokenStorage& tokenStorage();
 
         // true if new token generated
         bool feedChar(char ch);
         void feedStream(std::istream& stream);
+        // Feeds all of text, then eof()
+        void feedString(std::string_view text);
         void eof();
+        /*
+         * Stops keeping the source: the bytes the lexer is done with are dropped as it goes, so
+         * that only the lines kept for diagnostics grow with the input. applyEdit() is unavailable
+         * afterwards, and sourceText() and tokenSpelling() only cover the bytes still held.
+         * Call before feeding.
+         */
+        void discardSource();
 
         [[nodiscard]] bool tokenEmpty() const;
         [[nodiscard]] size_t tokenCount() const;
+        // Tokens that backing up to an earlier accept can no longer take back
+        [[nodiscard]] size_t settledTokenCount() const;
 
         [[nodiscard]] bool stopped() const;
 
+        /*
+         * Replaces removeLength bytes at offset with text. Relexing restarts from the last
+         * checkpoint before offset and stops at the first line start after the edit where the
+         * DFA state and partial token agree with the previous stream. Requires stopped() and
+         * that discardSource() was not called.
+         */
+        TokenEdit applyEdit(size_t offset, size_t removeLength, std::string_view text);
+        [[nodiscard]] const std::string& sourceText() const;
+        [[nodiscard]] TokenSpan tokenSpan(size_t index) const;
+        // The source bytes of a token, valid until the next feed or edit
+        [[nodiscard]] std::string_view tokenSpelling(size_t index) const;
+        [[nodiscard]] size_t checkpointCount() const;
+
         [[nodiscard]] size_t errorCount() const;
         [[nodiscard]] ErrorReport errorReportAt(size_t index) const;
         [[nodiscard]] const std::string& sourceLine(int lineNumber) const;
 
-        static const DeterministicAutomaton& getDFA();
+        [[nodiscard]] KeywordMatching keywordMatching() const { return keywords; }
+
+        // Built on first use, exactly once even if several threads ask; shared read-only afterwards
+        static const DeterministicAutomaton& getDFA(KeywordMatching keywordMatching = KeywordMatching::AUTOMATON);
     private:
         /*
         enum class CommentState {
@@ -121,27 +227,67 @@ namespace pl0cc {
         };
         */
 
+        // The DFA of one KeywordMatching and the states where it emits a token
+        struct Automaton {
+            std::unique_ptr<const DeterministicAutomaton> dfa;
+            std::vector<bool> acceptingStates;
+        };
+
+        KeywordMatching keywords;
+        const DeterministicAutomaton* automaton;
+        const std::vector<bool>* acceptingStates;
         DeterministicAutomaton::State state;
+        size_t scanned;     // Offset of the next source byte to run through the DFA
+        /*
+         * Maximal munch: once the DFA leaves an accepting state for a non-accepting one, the
+         * lexer speculates and acceptSnapshot holds the state right after the accept. A reject
+         * before the next accept backs up to it, emits the accepted token and rescans the rest.
+         * failedSteps remembers (state, offset) pairs from which a scan already ran into a reject
+         * without reaching an accept, so that no pair is scanned twice and lexing stays linear.
+         * It holds one bit per DFA state for every offset from failedBase on.
+         */
+        bool speculating;
+        Checkpoint acceptSnapshot;
+        std::vector<bool> failedSteps;
+        size_t failedBase;
+        size_t failedLimit;     // Furthest offset a backtracked scan looked at
         TokenStorage storage;
         int lineCounter, columnCounter;
         bool hasStopped;
+        bool keepingSource;
         std::string readingToken;
+        std::string source;
         std::vector<std::string> storedLines;
         std::vector<ErrorReport> errors;
+        std::vector<Checkpoint> checkpoints;
+        std::vector<TokenSpan> spans;
+        // Nonzero while applyEdit() relexes into emptied members, to keep offsets and counts absolute
+        size_t sourceBase, tokenBase, lineBase, errorBase;
         //std::string lastCommentToken;
         //CommentState commentState;
 
-        static std::unique_ptr<const DeterministicAutomaton> automaton;
-
-        bool generateTokenAndReset();
+        static Automaton automata[2];
+
+        bool generateTokenAndReset(size_t tokenEnd);
+        // Runs the DFA over the source from scanned on
+        bool scanSource();
+        bool scanChar(size_t offset);
+        // Drops the source bytes before the earliest one a backtrack may rescan
+        void discardScannedSource();
+        void backtrack(size_t rejectOffset);
+        [[nodiscard]] bool failedStep(DeterministicAutomaton::State from, size_t offset) const;
+        void recordCheckpoint(size_t offset);
+        [[nodiscard]] size_t sourceEnd() const { return sourceBase + source.size(); }
         void pushError(ErrorType type, const std::set<int>& possibleTokenTypes = {});
 
         template<typename... Args>
-        void pushToken(Args &&... args) {
-            storage.pushToken(RawToken(std::forward<Args>(args)...));
+        void pushToken(size_t offset, size_t length, Args &&... args) {
+            spans.push_back(TokenSpan{offset, length});
+            // While applyEdit() relexes, source holds only part of the text
+            storage.pushToken(RawToken(std::forward<Args>(args)...), sourceBase == 0 ? offset : StringPool::NOT_IN_SOURCE);
         }
 
-        static void buildAutomaton();
+        static void buildAutomaton(KeywordMatching keywordMatching);
     };
 
 } // pl0cc
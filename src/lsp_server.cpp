@@ -0,0 +1,537 @@
+#include "lsp_server.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+
+#include "incremental_parser.hpp"
+#include "lexer.hpp"
+
+using namespace pl0cc;
+
+namespace {
+    // JSON-RPC error codes
+    constexpr int PARSE_ERROR = -32700;
+    constexpr int INVALID_REQUEST = -32600;
+    constexpr int METHOD_NOT_FOUND = -32601;
+    constexpr int INTERNAL_ERROR = -32603;
+
+    // Indices into the semantic token legend sent with initialize
+    enum SemanticTokenType {
+        KEYWORD, TYPE, FUNCTION, VARIABLE, NUMBER, STRING, OPERATOR, NOT_HIGHLIGHTED
+    };
+    const char* const semanticTokenLegend[] = {
+        "keyword", "type", "function", "variable", "number", "string", "operator"
+    };
+
+    // LSP SymbolKind.Function and DiagnosticSeverity.Error
+    constexpr int SYMBOL_KIND_FUNCTION = 12;
+    constexpr int SEVERITY_ERROR = 1;
+
+    SemanticTokenType semanticTypeOf(TokenType type) {
+        switch (type) {
+            case TokenType::FN: case TokenType::IF: case TokenType::ELSE: case TokenType::FOR:
+            case TokenType::WHILE: case TokenType::BREAK: case TokenType::RETURN: case TokenType::CONTINUE:
+                return KEYWORD;
+            case TokenType::FLOAT: case TokenType::INT: case TokenType::CHAR:
+                return TYPE;
+            case TokenType::SYMBOL:
+                return VARIABLE;
+            case TokenType::NUMBER:
+                return NUMBER;
+            case TokenType::STRING:
+                return STRING;
+            case TokenType::OP_PLUS: case TokenType::OP_SUB: case TokenType::OP_MUL: case TokenType::OP_DIV:
+            case TokenType::OP_MOD: case TokenType::OP_GT: case TokenType::OP_GE: case TokenType::OP_LT:
+            case TokenType::OP_LE: case TokenType::OP_NEQ: case TokenType::OP_EQU: case TokenType::OP_NOT:
+            case TokenType::OP_AND: case TokenType::OP_OR: case TokenType::ASSIGN: case TokenType::ARROW:
+                return OPERATOR;
+            default:
+                return NOT_HIGHLIGHTED;
+        }
+    }
+
+    JsonValue response(const JsonValue& id, JsonValue result) {
+        JsonValue message;
+        message["jsonrpc"] = "2.0";
+        message["id"] = id;
+        message["result"] = std::move(result);
+        return message;
+    }
+
+    JsonValue errorResponse(const JsonValue& id, int code, const std::string& what) {
+        JsonValue message;
+        message["jsonrpc"] = "2.0";
+        message["id"] = id;
+        message["error"]["code"] = code;
+        message["error"]["message"] = what;
+        return message;
+    }
+
+    JsonValue notification(const char* method, JsonValue params) {
+        JsonValue message;
+        message["jsonrpc"] = "2.0";
+        message["method"] = method;
+        message["params"] = std::move(params);
+        return message;
+    }
+
+    void writeMessage(std::ostream& out, const JsonValue& message) {
+        std::string body = message.serialize();
+        out << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+        out.flush();
+    }
+
+    // Larger bodies are skipped unread rather than buffered
+    constexpr size_t MAX_MESSAGE_LENGTH = size_t(64) << 20;
+
+    enum class Frame { MESSAGE, MALFORMED, END };
+
+    /*
+     * Reads one framed message body. A header without a usable Content-Length, or a body over
+     * MAX_MESSAGE_LENGTH, yields MALFORMED with the reason in body; the oversized body is skipped.
+     */
+    Frame readMessage(std::istream& in, std::string& body) {
+        std::string line;
+        size_t length = 0;
+        bool hasLength = false, badLength = false;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) {
+                if (badLength) {
+                    body = "Invalid Content-Length header";
+                    return Frame::MALFORMED;
+                }
+                if (!hasLength) continue;
+                if (length > MAX_MESSAGE_LENGTH) {
+                    in.ignore(std::streamsize(std::min(length, size_t(std::numeric_limits<std::streamsize>::max()))));
+                    body = "Content-Length exceeds the limit of " + std::to_string(MAX_MESSAGE_LENGTH) + " bytes";
+                    return in ? Frame::MALFORMED : Frame::END;
+                }
+                body.resize(length);
+                in.read(body.data(), std::streamsize(length));
+                return size_t(in.gcount()) == length ? Frame::MESSAGE : Frame::END;
+            }
+            constexpr std::string_view header = "Content-Length:";
+            if (line.compare(0, header.size(), header) == 0) {
+                const char* first = line.data() + header.size();
+                const char* last = line.data() + line.size();
+                while (first != last && (*first == ' ' || *first == '\t')) first++;
+                while (last != first && (last[-1] == ' ' || last[-1] == '\t')) last--;
+                auto [end, error] = std::from_chars(first, last, length);
+                hasLength = error == std::errc() && end == last;
+                // A value too large for size_t is still a well-formed number, just over the limit
+                if (error == std::errc::result_out_of_range && end == last) {
+                    length = std::numeric_limits<size_t>::max();
+                    hasLength = true;
+                }
+                badLength = !hasLength;
+            }
+        }
+        return Frame::END;
+    }
+}
+
+/*
+ * An open text document. The lexer holds the source text and the token spans, the parser
+ * the tree of the last error-free token stream. lineStarts indexes the source for
+ * converting between LSP positions and byte offsets; utf16 says whether position characters
+ * count UTF-16 code units rather than bytes.
+ */
+struct LspServer::Document {
+    std::unique_ptr<Lexer> lexer;
+    IncrementalParser parser;
+    std::vector<size_t> lineStarts;
+    std::optional<std::tuple<int, int, int>> parseError;
+    // Set by load() until the new text is parsed; the parser's tree belongs to the old one
+    bool treeStale;
+    double version;
+    bool utf16;
+
+    Document(const Syntax& syntax, const LlMap& llMap, bool utf16) :
+        lexer(), parser(syntax, llMap), lineStarts(), parseError(), treeStale(true), version(0), utf16(utf16) {}
+
+    void load(const std::string& text) {
+        lexer = std::make_unique<Lexer>();
+        for (char ch : text) lexer->feedChar(ch);
+        lexer->eof();
+
+        lineStarts.assign(1, 0);
+        scanLineStarts(0, text.size());
+        treeStale = true;
+        analyze(nullptr);
+    }
+
+    void edit(size_t offset, size_t removeLength, std::string_view text) {
+        Lexer::TokenEdit tokenEdit = lexer->applyEdit(offset, removeLength, text);
+
+        // Drop the line starts inside the replaced range, shift the later ones and scan the new text.
+        // Scanning starts one byte early, since a '\r' before the edit may end a line now.
+        auto first = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+        auto last = std::upper_bound(first, lineStarts.end(), offset + removeLength);
+        for (auto it = last; it != lineStarts.end(); ++it) *it = *it - removeLength + text.size();
+        lineStarts.erase(first, last);
+        scanLineStarts(offset == 0 ? 0 : offset - 1, offset + text.size() + 1);
+
+        analyze(&tokenEdit);
+    }
+
+    // Replaces the line starts in (from, to] by those after the line breaks in [from, to) of the source
+    void scanLineStarts(size_t from, size_t to) {
+        const std::string& source = lexer->sourceText();
+        to = std::min(to, source.size());
+        std::vector<size_t> found;
+        for (size_t i = from; i < to; i++) {
+            if (source[i] == '\n' || (source[i] == '\r' && (i + 1 == source.size() || source[i + 1] != '\n'))) {
+                found.push_back(i + 1);
+            }
+        }
+        auto at = std::upper_bound(lineStarts.begin(), lineStarts.end(), from);
+        auto end = at;
+        while (end != lineStarts.end() && *end <= to) end++;
+        at = lineStarts.erase(at, end);
+        lineStarts.insert(at, found.begin(), found.end());
+    }
+
+    // Token streams with lexer errors are not parsed
+    void analyze(const Lexer::TokenEdit* tokenEdit) {
+        parseError.reset();
+        if (lexer->errorCount() > 0) {
+            if (tokenEdit != nullptr) parser.deferEdit(*tokenEdit);
+            return;
+        }
+        try {
+            if (treeStale || tokenEdit == nullptr) {
+                parser.parse(lexer->tokenStorage());
+            } else {
+                parser.reparse(lexer->tokenStorage(), *tokenEdit);
+            }
+        } catch (const std::tuple<int, int, int>& err) {
+            parseError = err;
+        }
+        treeStale = false;
+    }
+
+    [[nodiscard]] size_t offsetAt(const JsonValue& position) const {
+        const size_t size = lexer->sourceText().size();
+        size_t line = size_t(position["line"].asNumber());
+        if (line >= lineStarts.size()) return size;
+        size_t lineEnd = line + 1 < lineStarts.size() ? lineStarts[line + 1] : size;
+        return offsetAfter(lineStarts[line], lineEnd, size_t(position["character"].asNumber()));
+    }
+
+    [[nodiscard]] JsonValue positionAt(size_t offset) const {
+        size_t line = size_t(std::upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin()) - 1;
+        JsonValue position;
+        position["line"] = line;
+        position["character"] = unitsBetween(lineStarts[line], offset);
+        return position;
+    }
+
+    // Length of the source in [from, to) in position units
+    [[nodiscard]] size_t unitsBetween(size_t from, size_t to) const {
+        if (!utf16) return to - from;
+        const std::string& source = lexer->sourceText();
+        size_t units = 0;
+        for (size_t i = from; i < to; i++) {
+            auto byte = static_cast<unsigned char>(source[i]);
+            // Code points past U+FFFF, led by 0xF0 and above, take a surrogate pair
+            if ((byte & 0xC0) != 0x80) units += byte >= 0xF0 ? 2 : 1;
+        }
+        return units;
+    }
+
+    // The offset units position units after from, stopping at to and never inside a character
+    [[nodiscard]] size_t offsetAfter(size_t from, size_t to, size_t units) const {
+        if (!utf16) return std::min(from + units, to);
+        const std::string& source = lexer->sourceText();
+        size_t offset = from;
+        while (offset < to) {
+            size_t width = static_cast<unsigned char>(source[offset]) >= 0xF0 ? 2 : 1;
+            if (units < width) break;
+            units -= width;
+            offset++;
+            while (offset < to && (static_cast<unsigned char>(source[offset]) & 0xC0) == 0x80) offset++;
+        }
+        return offset;
+    }
+
+    [[nodiscard]] JsonValue rangeOf(size_t offset, size_t length) const {
+        JsonValue range;
+        range["start"] = positionAt(offset);
+        range["end"] = positionAt(offset + length);
+        return range;
+    }
+
+    // The first token whose span starts at or after offset
+    [[nodiscard]] size_t tokenAt(size_t offset) const {
+        size_t low = 0, high = lexer->tokenCount();
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (lexer->tokenSpan(mid).offset < offset) low = mid + 1;
+            else high = mid;
+        }
+        return low;
+    }
+};
+
+LspServer::LspServer() :
+    syntax(genSyntax()), llMap(syntax.llMap()), documents(), utf16Positions(true),
+    shutdownReceived(false), exitReceived(false) {
+    Lexer::getDFA();
+}
+
+LspServer::~LspServer() = default;
+
+std::vector<JsonValue> LspServer::handle(const JsonValue& message) {
+    std::vector<JsonValue> out;
+    // Responses to our requests are ignored; the server sends none
+    if (message["method"].type() != JsonValue::Type::STRING) return out;
+
+    const std::string& method = message["method"].asString();
+    const JsonValue& params = message["params"];
+    const bool isRequest = message.contains("id");
+    const JsonValue& id = message["id"];
+
+    try {
+        if (method == "exit") {
+            exitReceived = true;
+        } else if (shutdownReceived) {
+            if (isRequest) out.push_back(errorResponse(id, INVALID_REQUEST, "Server is shutting down"));
+        } else if (method == "initialize") {
+            out.push_back(response(id, initialize(params)));
+        } else if (method == "initialized") {
+        } else if (method == "shutdown") {
+            shutdownReceived = true;
+            out.push_back(response(id, nullptr));
+        } else if (method == "textDocument/didOpen") {
+            const JsonValue& item = params["textDocument"];
+            const std::string& uri = item["uri"].asString();
+            auto doc = std::make_unique<Document>(syntax, llMap, utf16Positions);
+            doc->version = item["version"].isNull() ? 0 : item["version"].asNumber();
+            doc->load(item["text"].asString());
+            documents[uri] = std::move(doc);
+            out.push_back(notification("textDocument/publishDiagnostics", diagnostics(uri)));
+        } else if (method == "textDocument/didChange") {
+            Document& doc = document(params);
+            for (const JsonValue& change : params["contentChanges"].asArray()) {
+                if (change.contains("range")) {
+                    size_t from = doc.offsetAt(change["range"]["start"]);
+                    size_t to = std::max(from, doc.offsetAt(change["range"]["end"]));
+                    doc.edit(from, to - from, change["text"].asString());
+                } else {
+                    doc.load(change["text"].asString());
+                }
+            }
+            if (!params["textDocument"]["version"].isNull()) doc.version = params["textDocument"]["version"].asNumber();
+            out.push_back(notification("textDocument/publishDiagnostics", diagnostics(params["textDocument"]["uri"].asString())));
+        } else if (method == "textDocument/didClose") {
+            const std::string& uri = params["textDocument"]["uri"].asString();
+            documents.erase(uri);
+            JsonValue cleared;
+            cleared["uri"] = uri;
+            cleared["diagnostics"] = JsonValue::Array();
+            out.push_back(notification("textDocument/publishDiagnostics", std::move(cleared)));
+        } else if (method == "textDocument/semanticTokens/full") {
+            out.push_back(response(id, semanticTokens(params, false)));
+        } else if (method == "textDocument/semanticTokens/range") {
+            out.push_back(response(id, semanticTokens(params, true)));
+        } else if (method == "textDocument/documentSymbol") {
+            out.push_back(response(id, documentSymbols(params)));
+        } else if (isRequest) {
+            out.push_back(errorResponse(id, METHOD_NOT_FOUND, "Unsupported method " + method));
+        }
+    } catch (const std::exception& e) {
+        if (isRequest) out.push_back(errorResponse(id, INTERNAL_ERROR, e.what()));
+    }
+    return out;
+}
+
+int LspServer::run(std::istream& in, std::ostream& out, std::ostream* record) {
+    std::string body;
+    Frame frame;
+    while (!exitReceived && (frame = readMessage(in, body)) != Frame::END) {
+        if (frame == Frame::MALFORMED) {
+            writeMessage(out, errorResponse(nullptr, INVALID_REQUEST, body));
+            continue;
+        }
+        JsonValue message;
+        try {
+            message = JsonValue::parse(body);
+        } catch (const std::runtime_error& e) {
+            writeMessage(out, errorResponse(nullptr, PARSE_ERROR, e.what()));
+            continue;
+        }
+        if (record != nullptr) {
+            message.serializeTo(*record);
+            *record << '\n';
+        }
+        for (const JsonValue& reply : handle(message)) writeMessage(out, reply);
+    }
+    if (record != nullptr) record->flush();
+    return exitCode();
+}
+
+LspServer::Document& LspServer::document(const JsonValue& params) {
+    auto it = documents.find(params["textDocument"]["uri"].asString());
+    if (it == documents.end()) throw std::runtime_error("Document is not open");
+    return *it->second;
+}
+
+JsonValue LspServer::initialize(const JsonValue& params) {
+    // Byte columns need no conversion, but UTF-16 is what a client that does not offer utf-8 sends
+    utf16Positions = true;
+    const JsonValue& offered = params["capabilities"]["general"]["positionEncodings"];
+    if (offered.type() == JsonValue::Type::ARRAY) {
+        for (const JsonValue& encoding : offered.asArray()) {
+            if (encoding.type() == JsonValue::Type::STRING && encoding.asString() == "utf-8") utf16Positions = false;
+        }
+    }
+    for (auto& entry : documents) entry.second->utf16 = utf16Positions;
+
+    JsonValue legend;
+    legend["tokenTypes"] = JsonValue::Array(std::begin(semanticTokenLegend), std::end(semanticTokenLegend));
+    legend["tokenModifiers"] = JsonValue::Array();
+
+    JsonValue capabilities;
+    capabilities["positionEncoding"] = utf16Positions ? "utf-16" : "utf-8";
+    capabilities["textDocumentSync"] = 2;   // Incremental
+    capabilities["semanticTokensProvider"]["legend"] = std::move(legend);
+    capabilities["semanticTokensProvider"]["full"] = true;
+    capabilities["semanticTokensProvider"]["range"] = true;
+    capabilities["documentSymbolProvider"] = true;
+
+    JsonValue result;
+    result["capabilities"] = std::move(capabilities);
+    result["serverInfo"]["name"] = "pl0cc";
+    result["serverInfo"]["version"] = "0.1";
+    return result;
+}
+
+JsonValue LspServer::semanticTokens(const JsonValue& params, bool ranged) {
+    const Document& doc = document(params);
+    const Lexer& lexer = *doc.lexer;
+    const TokenStorage& ts = doc.lexer->tokenStorage();
+
+    size_t first = 0, last = ts.size();
+    if (ranged) {
+        first = doc.tokenAt(doc.offsetAt(params["range"]["start"]));
+        last = doc.tokenAt(doc.offsetAt(params["range"]["end"]));
+    }
+
+    // Five numbers per token: line and start relative to the previous token, length, type, modifiers
+    JsonValue::Array data;
+    size_t line = 0, lastLine = 0, lastStart = 0, lastOffset = 0;
+    TokenType previous = TokenType::NEWLINE;
+    if (first < last) {
+        // Start at the line of the first token, and see an fn right before the range
+        const size_t offset = lexer.tokenSpan(first).offset;
+        line = size_t(std::upper_bound(doc.lineStarts.begin(), doc.lineStarts.end(), offset) - doc.lineStarts.begin()) - 1;
+        for (size_t i = first; i-- > 0;) {
+            if (ts[i].type == TokenType::NEWLINE) continue;
+            previous = ts[i].type;
+            break;
+        }
+    }
+    for (size_t i = first; i < last; i++) {
+        const TokenType type = ts[i].type;
+        SemanticTokenType semanticType = semanticTypeOf(type);
+        if (type != TokenType::NEWLINE) {
+            // Functions are named after fn or called with '('
+            if (type == TokenType::SYMBOL && (previous == TokenType::FN ||
+                                              (i + 1 < ts.size() && ts[i + 1].type == TokenType::LSBRACKET))) {
+                semanticType = FUNCTION;
+            }
+            previous = type;
+        }
+        if (semanticType == NOT_HIGHLIGHTED) continue;
+
+        const Lexer::TokenSpan span = lexer.tokenSpan(i);
+        while (line + 1 < doc.lineStarts.size() && doc.lineStarts[line + 1] <= span.offset) line++;
+        // Counted on from the previous token of the line, so that UTF-16 columns stay linear in the line
+        const size_t start = line == lastLine && lastOffset >= doc.lineStarts[line]
+                             ? lastStart + doc.unitsBetween(lastOffset, span.offset)
+                             : doc.unitsBetween(doc.lineStarts[line], span.offset);
+        data.emplace_back(line - lastLine);
+        data.emplace_back(line == lastLine ? start - lastStart : start);
+        data.emplace_back(doc.unitsBetween(span.offset, span.offset + span.length));
+        data.emplace_back(int(semanticType));
+        data.emplace_back(0);
+        lastLine = line;
+        lastStart = start;
+        lastOffset = span.offset;
+    }
+
+    JsonValue result;
+    result["data"] = std::move(data);
+    return result;
+}
+
+JsonValue LspServer::documentSymbols(const JsonValue& params) {
+    const Document& doc = document(params);
+    JsonValue::Array symbols;
+    if (doc.treeStale || !doc.parser.upToDate()) return symbols;
+
+    const Lexer& lexer = *doc.lexer;
+    const TokenStorage& ts = doc.lexer->tokenStorage();
+    for (const IncrementalParser::Region& region : doc.parser.subtreeSpans()) {
+        if (region.parentRegion != IncrementalParser::NO_REGION || region.firstToken != TokenType::FN) continue;
+
+        size_t nameIndex = region.begin + 1;
+        while (nameIndex < region.end && ts[nameIndex].type == TokenType::NEWLINE) nameIndex++;
+        if (nameIndex >= region.end) continue;
+
+        const Lexer::TokenSpan begin = lexer.tokenSpan(region.begin);
+        const Lexer::TokenSpan end = lexer.tokenSpan(region.end - 1);
+        const Lexer::TokenSpan name = lexer.tokenSpan(nameIndex);
+
+        JsonValue symbol;
+        symbol["name"] = lexer.sourceText().substr(name.offset, name.length);
+        symbol["kind"] = SYMBOL_KIND_FUNCTION;
+        symbol["range"] = doc.rangeOf(begin.offset, end.offset + end.length - begin.offset);
+        symbol["selectionRange"] = doc.rangeOf(name.offset, name.length);
+        symbols.push_back(std::move(symbol));
+    }
+    return symbols;
+}
+
+JsonValue LspServer::diagnostics(const std::string& uri) const {
+    const Document& doc = *documents.at(uri);
+    const Lexer& lexer = *doc.lexer;
+
+    JsonValue::Array list;
+    auto add = [&](JsonValue range, std::string message) {
+        JsonValue diagnostic;
+        diagnostic["range"] = std::move(range);
+        diagnostic["severity"] = SEVERITY_ERROR;
+        diagnostic["source"] = "pl0cc";
+        diagnostic["message"] = std::move(message);
+        list.push_back(std::move(diagnostic));
+    };
+
+    for (size_t i = 0; i < lexer.errorCount(); i++) {
+        Lexer::ErrorReport report = lexer.errorReportAt(i);
+        size_t line = std::min(size_t(report.lineNumber()), doc.lineStarts.size() - 1);
+        size_t offset = doc.lineStarts[line] + size_t(report.columnNumber());
+        size_t length = std::min(size_t(report.tokenLength()), lexer.sourceText().size() - std::min(offset, lexer.sourceText().size()));
+        add(doc.rangeOf(std::min(offset, lexer.sourceText().size()), length), report.reason());
+    }
+
+    if (doc.parseError) {
+        size_t index = size_t(std::get<0>(*doc.parseError));
+        const Lexer::TokenSpan span = doc.lexer->tokenSpan(std::min(index, doc.lexer->tokenCount() - 1));
+        TokenType type = doc.lexer->tokenStorage()[std::min(index, doc.lexer->tokenCount() - 1)].type;
+        add(doc.rangeOf(span.offset, span.length),
+            type == TokenType::TOKEN_EOF ? "Unexpected end of file" : "Unexpected " + tokenTypeName(type));
+    }
+
+    JsonValue params;
+    params["uri"] = uri;
+    params["version"] = doc.version;
+    params["diagnostics"] = std::move(list);
+    return params;
+}
@@ -0,0 +1,63 @@
+#ifndef PL0CC_LSP_SERVER_HPP
+#define PL0CC_LSP_SERVER_HPP
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+#include "syntax.hpp"
+
+namespace pl0cc {
+    /*
+     * Language server speaking JSON-RPC with Content-Length framing, as in the LSP base protocol.
+     *
+     * The lexer DFA, the grammar and its LL(1) map are built once and shared by every open
+     * document. Each document keeps its Lexer and IncrementalParser, so an edit relexes from the
+     * nearest line checkpoint and reparses the enclosing STMT/FNDEF only. Requests are answered
+     * from that state:
+     *   textDocument/semanticTokens/full and /range  from the lexer's token spans,
+     *   textDocument/documentSymbol                  from the top-level FNDEF spans of the parser,
+     *   textDocument/publishDiagnostics              from Lexer::ErrorReport and the parse error.
+     * Positions count bytes within a line when the client offers the "utf-8" position encoding,
+     * and UTF-16 code units, the LSP default, otherwise.
+     */
+    class LspServer {
+    public:
+        LspServer();
+        ~LspServer();
+
+        // Handles one incoming message and returns the responses and notifications to send
+        std::vector<JsonValue> handle(const JsonValue& message);
+
+        [[nodiscard]] bool exitRequested() const { return exitReceived; }
+        // 0 if the client asked for shutdown before exit, 1 otherwise
+        [[nodiscard]] int exitCode() const { return shutdownReceived ? 0 : 1; }
+
+        /*
+         * Serves framed messages from in until exit or end of input and returns the exit code.
+         * With record, every incoming message is also written to it as a line of JSON,
+         * which pl0cc_lsp_replay can play back.
+         */
+        int run(std::istream& in, std::ostream& out, std::ostream* record = nullptr);
+    private:
+        struct Document;
+
+        Syntax syntax;
+        LlMap llMap;
+        std::map<std::string, std::unique_ptr<Document>> documents;
+        // Set by initialize: whether the client counts columns in UTF-16 code units
+        bool utf16Positions;
+        bool shutdownReceived, exitReceived;
+
+        Document& document(const JsonValue& params);
+        JsonValue initialize(const JsonValue& params);
+        JsonValue semanticTokens(const JsonValue& params, bool ranged);
+        JsonValue documentSymbols(const JsonValue& params);
+        JsonValue diagnostics(const std::string& uri) const;
+    };
+}
+
+#endif // PL0CC_LSP_SERVER_HPP
@@ -1,13 +1,36 @@
+#include <condition_variable>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <iterator>
+#include <mutex>
 #include <optional>
+#include <set>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <vector>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "artifact_cache.hpp"
+#include "ast.hpp"
+#include "binary_output.hpp"
+#include "compile_daemon.hpp"
+#include "lalr.hpp"
 #include "lexer.hpp"
+#include "lsp_server.hpp"
+#include "memory_report.hpp"
+#include "output_buffer.hpp"
+#include "rd_parser.hpp"
 #include "syntax.hpp"
+#include "thread_pool.hpp"
+#include "time_report.hpp"
+#include "token_pipeline.hpp"
+#include "input_reader.hpp"
+#include "trace.hpp"
 
 using namespace std;
 using pl0cc::Lexer, pl0cc::TokenStorage;
@@ -16,88 +39,625 @@ const char* CONSOLE_RED = "\033[31m";
 const char* CONSOLE_GREEN = "\033[32m";
 const char* CONSOLE_RESET = "\033[0m";
 
+namespace {
+    struct CompileOptions {
+        bool syntaxOnly = false;
+        bool emitAst = false;
+        bool useLalr = false;
+        bool useRecursiveDescent = false;
+        bool flatExpressions = false;
+        bool emitBinary = false;
+        bool pipelined = false;
+        bool asyncRead = false;
+        bool keywordHash = false;
+    };
+
+    Lexer::KeywordMatching keywordMatching(const CompileOptions& options) {
+        return options.keywordHash ? Lexer::KeywordMatching::PERFECT_HASH : Lexer::KeywordMatching::AUTOMATON;
+    }
+
+    // Built once and only read while files compile, possibly on several threads
+    struct SharedTables {
+        pl0cc::Syntax syntax;
+        pl0cc::LlMap llMap;
+        std::optional<pl0cc::OperatorPrecedenceTable> exprTable;
+        std::optional<pl0cc::LalrTable> lalrTable;
+        std::optional<pl0cc::ArtifactCache> cache;
+        pl0cc::TimeReport* timeReport = nullptr;   // Thread-safe; null unless --time-report
+    };
+
+    // Cache entries are only shared between compiles that used the same parser
+    std::string parserName(const CompileOptions& options) {
+        if (options.useLalr) return "lalr";
+        if (options.useRecursiveDescent) return "rd";
+        return options.flatExpressions ? "ll-flat" : "ll";
+    }
+
+    std::string cacheVersion() {
+        // Constants are pooled by value, not by spelling
+        return "pl0cc 0.1 numbers-by-value strings-by-value " + pl0cc::grammarFingerprint(pl0cc::genSyntax()) + " " + pl0cc::grammarFingerprint(pl0cc::genLrSyntax());
+    }
+
+    bool writeOutput(const std::string& outputFilename, const TokenStorage& ts, const pl0cc::SyntaxTree& tree, const CompileOptions& options) {
+        pl0cc::memory::PhaseScope outputPhase(pl0cc::memory::Phase::OUTPUT);
+        int fd = ::open(outputFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fd < 0) return false;
+
+        bool written;
+        {
+            pl0cc::OutputBuffer output(fd);
+            if (options.emitBinary) {
+                pl0cc::writeBinaryOutput(output, ts, tree);
+            } else if (options.emitAst) {
+                ts.serializeTo(output);
+                output.put("Abstract Syntax Tree:\n");
+                pl0cc::lowerSyntaxTree(tree).serializeTo(output);
+            } else {
+                ts.serializeTo(output);
+                output.put("Syntax Tree:\n");
+                tree.serializeTo(output, pl0cc::symbols::symbolToName);
+            }
+            written = output.flush();
+        }
+        return ::close(fd) == 0 && written;
+    }
+
+    // Compiles one file with its own Lexer and TokenStorage, writing diagnostics to log
+    int compileFile(const std::string& inputFilename, const std::string& outputFilename,
+                    const CompileOptions& options, const SharedTables& tables, ostream& log) {
+        PL0CC_TRACE_SCOPE_DETAIL("compile", inputFilename);
+        auto absoluteInputPath = filesystem::absolute(inputFilename);
+        using Phase = pl0cc::TimeReport::Phase;
+        using Counter = pl0cc::TimeReport::Counter;
+        pl0cc::TimeReport* report = tables.timeReport;
+
+        bool pipelined = options.pipelined;
+        // The cache key and the lexing thread need the whole source up front
+        std::optional<pl0cc::ChunkedFileReader> reader;
+        std::string source;
+        if (options.asyncRead && !tables.cache && !pipelined) {
+            pl0cc::memory::PhaseScope readPhase(pl0cc::memory::Phase::READ);
+            try {
+                reader.emplace(inputFilename);
+            } catch (const std::runtime_error&) {
+                log << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Cannot open " << inputFilename << "." << endl;
+                return EXIT_FAILURE;
+            }
+        } else {
+            ifstream input(inputFilename);
+            if (!input) {
+                log << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Cannot open " << inputFilename << "." << endl;
+                return EXIT_FAILURE;
+            }
+            pl0cc::TimeReport::Timer readTimer(report, Phase::READ);
+            PL0CC_TRACE_SCOPE("read");
+            pl0cc::memory::PhaseScope readPhase(pl0cc::memory::Phase::READ);
+            source.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+        }
+        if (report) {
+            report->count(Counter::FILES, 1);
+            if (!reader) report->count(Counter::INPUT_BYTES, source.size());
+        }
+
+        Lexer lexer(keywordMatching(options));
+        TokenStorage& ts = lexer.tokenStorage();
+
+        // A cached artifact stands for a successful lex and parse of the same bytes
+        std::optional<pl0cc::CacheKey> cacheKey;
+        if (tables.cache) {
+            cacheKey = tables.cache->keyOf(source, parserName(options));
+            if (options.syntaxOnly && tables.cache->contains(*cacheKey)) {
+                log << "pl0cc completed with " << CONSOLE_GREEN << "0" << CONSOLE_RESET << " errors occurred." << endl;
+                return EXIT_SUCCESS;
+            }
+            if (auto artifact = options.syntaxOnly ? std::nullopt : tables.cache->load(*cacheKey)) {
+                log << "pl0cc completed with " << CONSOLE_GREEN << "0" << CONSOLE_RESET << " errors occurred." << endl;
+                pl0cc::TimeReport::Timer outputTimer(report, Phase::OUTPUT);
+                if (!writeOutput(outputFilename, artifact->tokens, artifact->tree, options)) {
+                    log << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Cannot write " << outputFilename << "." << endl;
+                    return EXIT_FAILURE;
+                }
+                return EXIT_SUCCESS;
+            }
+        }
+
+        // Trees are still built for --syntax-only so that the cache can keep them
+        bool buildTree = !options.syntaxOnly || cacheKey;
+        const pl0cc::OperatorPrecedenceTable* exprTable = options.flatExpressions && tables.exprTable ? &*tables.exprTable : nullptr;
+        std::optional<pl0cc::SyntaxTree> optTree;
+        std::optional<std::tuple<int, int, int>> syntaxError;
+        size_t parseSteps = 0;
+        // The LL(1) parse, over a finished token stream or one that is still being lexed
+        auto llParse = [&](auto& tokens) {
+            if (!buildTree) {
+                pl0cc::NullParseSink sink;
+                pl0cc::CountingParseSink<pl0cc::NullParseSink> counting{sink};
+                pl0cc::llZeroParseTokens(tables.syntax, tables.llMap, tables.syntax.start(), tokens, counting, exprTable);
+                parseSteps = counting.steps;
+            } else {
+                pl0cc::SyntaxTreeBuilder builder;
+                pl0cc::CountingParseSink<pl0cc::SyntaxTreeBuilder> counting{builder};
+                pl0cc::llZeroParseTokens(tables.syntax, tables.llMap, tables.syntax.start(), tokens, counting, exprTable);
+                parseSteps = counting.steps;
+                optTree = builder.result();
+            }
+        };
+
+        if (pipelined) {
+            // The parse time covers the overlapping lexing as well
+            pl0cc::TimeReport::Timer parseTimer(report, Phase::PARSE);
+            try {
+                PL0CC_TRACE_SCOPE_DETAIL("parse", parserName(options));
+                pl0cc::memory::PhaseScope parsePhase(pl0cc::memory::Phase::PARSE);
+                pl0cc::lexAndParse(lexer, source, report, llParse);
+            } catch (std::tuple<int, int, int> err) {
+                syntaxError = err;
+            }
+        } else if (reader) {
+            try {
+                // Nothing edits this lexer, so it need not keep the bytes it has lexed
+                lexer.discardSource();
+                pl0cc::lexChunks(lexer, *reader, report);
+            } catch (const std::runtime_error& err) {
+                log << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": " << err.what() << "." << endl;
+                return EXIT_FAILURE;
+            }
+        } else {
+            pl0cc::TimeReport::Timer lexTimer(report, Phase::LEX);
+            pl0cc::memory::PhaseScope lexPhase(pl0cc::memory::Phase::LEX);
+            lexer.feedString(source);
+        }
+        if (report) {
+            if (reader) report->count(Counter::INPUT_BYTES, reader->bytesRead());
+            report->count(Counter::TOKENS, ts.size());
+        }
+
+        if (!lexer.stopped()) {
+            log << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Lexer hasn't stopped." << endl;
+            return EXIT_FAILURE;
+        }
+
+        log << "pl0cc completed with ";
+        if (lexer.errorCount() == 0) {
+            // A pipelined compile has parsed while lexing
+            if (!pipelined) {
+                pl0cc::TimeReport::Timer parseTimer(report, Phase::PARSE);
+                try {
+                    PL0CC_TRACE_SCOPE_DETAIL("parse", parserName(options));
+                    pl0cc::memory::PhaseScope parsePhase(pl0cc::memory::Phase::PARSE);
+                    if (options.useLalr) {
+                        optTree = pl0cc::lalrParseSyntax(*tables.lalrTable, ts);
+                    } else if (options.useRecursiveDescent && !buildTree) {
+                        pl0cc::rdCheckSyntax(ts);
+                    } else if (options.useRecursiveDescent) {
+                        optTree = pl0cc::rdParseSyntax(ts);
+                    } else {
+                        pl0cc::TokenStorageCursor tokens(ts, 0);
+                        llParse(tokens);
+                    }
+                } catch (std::tuple<int, int, int> err) {
+                    syntaxError = err;
+                }
+            }
+            if (syntaxError) {
+                auto [index, line, token] = *syntaxError;
+                log << "Syntax parser reported an " << CONSOLE_RED << "error" << CONSOLE_RESET << " at line " << (line+1) << " token " << (token+1) << "." << endl;
+                log << "---------------------" << std::endl;
+                log << line+1 << " |\t" << lexer.sourceLine(line) << std::endl;
+                return EXIT_FAILURE;
+            }
+            if (report) {
+                report->count(Counter::PARSE_STEPS, parseSteps);
+                if (optTree) report->count(Counter::TREE_NODES, optTree->nodeCount());
+            }
+
+            log << CONSOLE_GREEN << "0" << CONSOLE_RESET << " errors occurred." << endl;
+            if (cacheKey) tables.cache->store(*cacheKey, ts, optTree.value());
+            if (options.syntaxOnly) return EXIT_SUCCESS;
+
+            pl0cc::TimeReport::Timer outputTimer(report, Phase::OUTPUT);
+            if (!writeOutput(outputFilename, ts, optTree.value(), options)) {
+                log << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Cannot write " << outputFilename << "." << endl;
+                return EXIT_FAILURE;
+            }
+        } else {
+            log << CONSOLE_RED << lexer.errorCount() << CONSOLE_RESET << " lexer errors occurred." << endl;
+            log << endl;
+            for (size_t i=0; i<lexer.errorCount(); i++) {
+                Lexer::ErrorReport report = lexer.errorReportAt(i);
+
+                string srcFile = absoluteInputPath.string() + ":" + to_string(report.lineNumber() + 1) + ":" + to_string(report.columnNumber() + 1);
+                log << "Error " << (i+1) << " at " << srcFile << ": " << std::endl;
+                report.reportErrorTo(log);
+            }
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    // Appends the whitespace-separated file names in a response file
+    bool readResponseFile(const std::string& filename, vector<string>& inputFilenames) {
+        ifstream response(filename);
+        if (!response) return false;
+        string name;
+        while (response >> name) inputFilenames.push_back(name);
+        return true;
+    }
+
+    // Options a daemon request may carry; false for anything else
+    bool applyCompileFlag(std::string_view flag, CompileOptions& options) {
+        if (flag == "syntax-only") options.syntaxOnly = true;
+        else if (flag == "flat-expr") options.flatExpressions = true;
+        else if (flag == "ast") options.emitAst = true;
+        else if (flag == "lalr") options.useLalr = true;
+        else if (flag == "rd") options.useRecursiveDescent = true;
+        else if (flag == "emit-binary") options.emitBinary = true;
+        else if (flag == "pipeline") options.pipelined = true;
+        else if (flag == "async-read") options.asyncRead = true;
+        else if (flag == "keyword-hash") options.keywordHash = true;
+        else return false;
+        return true;
+    }
+
+    // Rejects options that would otherwise be ignored in silence
+    bool checkCompileOptions(const CompileOptions& options, ostream& log) {
+        const char* conflict = nullptr;
+        if (options.emitBinary && options.emitAst) {
+            conflict = "--emit=binary holds the syntax tree and cannot be combined with --ast";
+        } else if (options.flatExpressions && (options.useLalr || options.useRecursiveDescent)) {
+            conflict = "--flat-expr only applies to the LL(1) parser and cannot be combined with --lalr or --rd";
+        } else if (options.pipelined && (options.useLalr || options.useRecursiveDescent)) {
+            conflict = "--pipeline only applies to the LL(1) parser and cannot be combined with --lalr or --rd";
+        }
+        if (conflict != nullptr) log << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": " << conflict << "." << endl;
+        return conflict == nullptr;
+    }
+
+    std::vector<std::string> compileFlags(const CompileOptions& options) {
+        std::vector<std::string> flags;
+        if (options.syntaxOnly) flags.emplace_back("syntax-only");
+        if (options.flatExpressions) flags.emplace_back("flat-expr");
+        if (options.emitAst) flags.emplace_back("ast");
+        if (options.useLalr) flags.emplace_back("lalr");
+        if (options.useRecursiveDescent) flags.emplace_back("rd");
+        if (options.emitBinary) flags.emplace_back("emit-binary");
+        if (options.pipelined) flags.emplace_back("pipeline");
+        if (options.asyncRead) flags.emplace_back("async-read");
+        if (options.keywordHash) flags.emplace_back("keyword-hash");
+        return flags;
+    }
+
+    /*
+     * With several inputs, -o names a directory that mirrors the inputs: sub/a.pl0 is written to
+     * <directory>/sub/a.pl0.out. An input outside the working directory keeps its absolute path there.
+     */
+    bool planOutputs(const std::vector<std::string>& inputFilenames, const std::string& outputFilename,
+                     const CompileOptions& options, std::vector<std::string>& outputFilenames, ostream& log) {
+        outputFilenames.assign(inputFilenames.size(), std::string());
+        if (options.syntaxOnly) return true;
+        if (inputFilenames.size() == 1) {
+            outputFilenames[0] = outputFilename;
+            return true;
+        }
+        const filesystem::path workingDirectory = filesystem::current_path();
+        std::set<std::string> seen;
+        for (size_t i = 0; i < inputFilenames.size(); i++) {
+            filesystem::path input = filesystem::absolute(inputFilenames[i]).lexically_normal();
+            filesystem::path relative = input.lexically_relative(workingDirectory);
+            if (relative.empty() || *relative.begin() == "..") relative = input.relative_path();
+            filesystem::path output = filesystem::path(outputFilename) / relative;
+            output += ".out";
+            if (!seen.insert(output.string()).second) {
+                log << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Input " << inputFilenames[i] << " is given more than once." << endl;
+                return false;
+            }
+            filesystem::create_directories(output.parent_path());
+            outputFilenames[i] = output.string();
+        }
+        return true;
+    }
+
+    /*
+     * Files compile in any order on pool; their diagnostics go to log in input order as they become ready.
+     * Only this call's own tasks are waited for, so several calls can share the pool at once.
+     */
+    int compileAll(const std::vector<std::string>& inputFilenames, const std::vector<std::string>& outputFilenames,
+                   const CompileOptions& options, const SharedTables& tables, pl0cc::WorkStealingPool& pool, ostream& log) {
+        struct Result {
+            std::string log;
+            int status = EXIT_SUCCESS;
+            bool done = false;
+        };
+        std::vector<Result> results(inputFilenames.size());
+        std::mutex resultMutex;
+        std::condition_variable resultReady;
+
+        for (size_t i = 0; i < inputFilenames.size(); i++) {
+            pool.submit([&, i] {
+                ostringstream fileLog;
+                if (inputFilenames.size() > 1) fileLog << "pl0cc: " << inputFilenames[i] << '\n';
+                int status;
+                try {
+                    status = compileFile(inputFilenames[i], outputFilenames[i], options, tables, fileLog);
+                } catch (const std::exception& e) {
+                    fileLog << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": " << e.what() << endl;
+                    status = EXIT_FAILURE;
+                }
+                // Notified under the lock: once the last result is seen, this call returns and its locals go
+                std::lock_guard<std::mutex> lock(resultMutex);
+                results[i] = Result{fileLog.str(), status, true};
+                resultReady.notify_all();
+            });
+        }
+
+        int status = EXIT_SUCCESS;
+        for (Result& result : results) {
+            {
+                std::unique_lock<std::mutex> lock(resultMutex);
+                resultReady.wait(lock, [&result] { return result.done; });
+            }
+            log << result.log << flush;
+            if (result.status != EXIT_SUCCESS) status = EXIT_FAILURE;
+        }
+        return status;
+    }
+
+    // Keeps every table and the pool warm and compiles what clients send until stopped
+    int serveDaemon(const std::string& socketPath, size_t jobs, const std::string& cacheDirectory, std::uint64_t cacheLimit) {
+        SharedTables tables{pl0cc::genSyntax(), {}, std::nullopt, std::nullopt, std::nullopt};
+        if (!cacheDirectory.empty()) tables.cache.emplace(cacheDirectory, cacheVersion(), cacheLimit);
+        tables.llMap = tables.syntax.llMap();
+        tables.exprTable = pl0cc::genOperatorTable(tables.syntax);
+        tables.lalrTable.emplace(pl0cc::genLrSyntax());
+        Lexer::getDFA(Lexer::KeywordMatching::AUTOMATON);
+        Lexer::getDFA(Lexer::KeywordMatching::PERFECT_HASH);
+        pl0cc::symbols::symbolToNameMap();
+        pl0cc::WorkStealingPool pool(jobs);
+
+        pl0cc::CompileDaemon daemon(socketPath, [&](const pl0cc::CompileRequest& request, ostream& client) {
+            CompileOptions options;
+            for (const std::string& flag : request.flags) {
+                if (!applyCompileFlag(flag, options)) {
+                    client << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Unknown option --" << flag << "." << endl;
+                    return EXIT_FAILURE;
+                }
+            }
+            if (!checkCompileOptions(options, client)) return EXIT_FAILURE;
+            if (request.inputs.empty() || request.outputs.size() != request.inputs.size()) {
+                client << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Malformed compile request." << endl;
+                return EXIT_FAILURE;
+            }
+            return compileAll(request.inputs, request.outputs, options, tables, pool, client);
+        });
+        clog << "pl0cc: daemon listening on " << socketPath << " with " << pool.threadCount() << " threads" << endl;
+        daemon.serve();
+        return EXIT_SUCCESS;
+    }
+}
+
 int main(int argc, char **argv) {
-    std::string inputFilename, outputFilename;
+    std::vector<std::string> inputFilenames;
+    std::string outputFilename;
+    CompileOptions options;
     bool showAutomaton = false;
+    bool serveLsp = false;
+    bool daemonMode = false;
+    bool useDaemon = false;
+    bool stopDaemon = false;
+    std::string socketPath;
+    std::string cacheDirectory;
+    std::uint64_t cacheLimit = std::uint64_t(256) << 20;
+    std::string lspRecordFilename;
+    bool printTimeReport = false;
+    std::string timeReportJsonFilename;
+    std::string traceFilename;
+    bool printMemoryReport = false;
+    std::string memoryReportJsonFilename;
+    size_t jobs = 0;
+    std::string_view daemonSetting;    // A daemon-wide option given to this process
     int rd = 1;
     while (rd < argc) {
         std::string_view s(argv[rd]);
         if (s == "-o" && rd + 1 < argc) {
             outputFilename = argv[++rd];
+        } else if (s == "-j" && rd + 1 < argc) {
+            jobs = size_t(std::max(0, atoi(argv[++rd])));
+            daemonSetting = s;
         } else if (s == "--automaton") {
             showAutomaton = true;
+        } else if (s == "--syntax-only") {
+            options.syntaxOnly = true;
+        } else if (s == "--flat-expr") {
+            options.flatExpressions = true;
+        } else if (s == "--ast") {
+            options.emitAst = true;
+        } else if (s == "--emit=text" || s == "--emit=binary") {
+            options.emitBinary = s == "--emit=binary";
+        } else if (s == "--pipeline") {
+            options.pipelined = true;
+        } else if (s == "--async-read") {
+            options.asyncRead = true;
+        } else if (s == "--keyword-hash") {
+            options.keywordHash = true;
+        } else if (s == "--lalr") {
+            options.useLalr = true;
+        } else if (s == "--rd") {
+            options.useRecursiveDescent = true;
+        } else if (s == "--lsp") {
+            serveLsp = true;
+        } else if (s == "--lsp-record" && rd + 1 < argc) {
+            lspRecordFilename = argv[++rd];
+        } else if (s == "--daemon") {
+            daemonMode = true;
+        } else if (s == "--use-daemon") {
+            useDaemon = true;
+        } else if (s == "--daemon-stop") {
+            stopDaemon = true;
+        } else if (s == "--socket" && rd + 1 < argc) {
+            socketPath = argv[++rd];
+        } else if (s == "--time-report") {
+            printTimeReport = true;
+        } else if (s == "--time-report-json" && rd + 1 < argc) {
+            timeReportJsonFilename = argv[++rd];
+        } else if (s == "--mem-report") {
+            printMemoryReport = true;
+        } else if (s == "--mem-report-json" && rd + 1 < argc) {
+            memoryReportJsonFilename = argv[++rd];
+        } else if (s == "--trace" && rd + 1 < argc) {
+            traceFilename = argv[++rd];
+        } else if (s == "--cache-dir" && rd + 1 < argc) {
+            cacheDirectory = argv[++rd];
+            daemonSetting = s;
+        } else if (s == "--cache-size" && rd + 1 < argc) {
+            cacheLimit = std::uint64_t(std::max(0, atoi(argv[++rd]))) << 20;
+            daemonSetting = s;
+        } else if (s.size() > 1 && s[0] == '@') {
+            if (!readResponseFile(argv[rd] + 1, inputFilenames)) {
+                clog << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Cannot read response file " << (argv[rd] + 1) << "." << endl;
+                return EXIT_FAILURE;
+            }
         } else {
-            inputFilename = argv[rd];
+            inputFilenames.emplace_back(argv[rd]);
         }
         rd++;
     }
 
-    if (inputFilename.empty()) {
+    // Language server on stdin/stdout; logs must not go to stdout
+    if (serveLsp) {
+        ofstream record;
+        if (!lspRecordFilename.empty()) record.open(lspRecordFilename);
+        return pl0cc::LspServer().run(cin, cout, record.is_open() ? &record : nullptr);
+    }
+
+    try {
+        if (socketPath.empty() && (daemonMode || stopDaemon || useDaemon)) socketPath = pl0cc::defaultDaemonSocket();
+        if (daemonMode) return serveDaemon(socketPath, jobs, cacheDirectory, cacheLimit);
+        if (stopDaemon) {
+            pl0cc::requestStop(socketPath);
+            return EXIT_SUCCESS;
+        }
+    } catch (const std::runtime_error& e) {
+        clog << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": " << e.what() << "." << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (inputFilenames.empty()) {
         clog << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Input file not specified." << endl;
         return EXIT_FAILURE;
     }
 
-    if (outputFilename.empty()) {
+    if (outputFilename.empty() && !options.syntaxOnly) {
         clog << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Output file not specified." << endl;
         return EXIT_FAILURE;
     }
 
-    clog << "pl0cc v0.1\n";
+    if (!checkCompileOptions(options, clog)) return EXIT_FAILURE;
 
-    if (showAutomaton) {
-        clog << "Automaton >--------------\n";
-        clog << Lexer::getDFA().serialize() << '\n';
+    if (useDaemon && !daemonSetting.empty()) {
+        clog << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": " << daemonSetting
+             << " is set when the daemon starts and cannot be combined with --use-daemon." << endl;
+        return EXIT_FAILURE;
     }
 
-    auto absoluteInputPath = filesystem::absolute(inputFilename);
-
-    ifstream input(inputFilename);
-    Lexer lexer;
-    TokenStorage& ts = lexer.tokenStorage();
+    std::vector<std::string> outputFilenames;
+    if (!planOutputs(inputFilenames, outputFilename, options, outputFilenames, clog)) return EXIT_FAILURE;
 
-    lexer.feedStream(input);
-    input.close();
+    // The daemon may run in another directory, so it gets absolute paths
+    if (useDaemon) {
+        pl0cc::CompileRequest request{compileFlags(options), {}, {}};
+        for (size_t i = 0; i < inputFilenames.size(); i++) {
+            request.inputs.push_back(filesystem::absolute(inputFilenames[i]).string());
+            request.outputs.push_back(outputFilenames[i].empty() ? "" : filesystem::absolute(outputFilenames[i]).string());
+        }
+        try {
+            return pl0cc::requestCompile(socketPath, request, clog);
+        } catch (const std::runtime_error& e) {
+            clog << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": " << e.what() << "." << endl;
+            return EXIT_FAILURE;
+        }
+    }
 
-    if (!lexer.stopped()) {
-        clog << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Lexer hasn't stopped." << endl;
+    if (!traceFilename.empty() && !pl0cc::trace::compiledIn()) {
+        clog << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": --trace needs a build configured with -DPL0CC_TRACING=ON." << endl;
         return EXIT_FAILURE;
     }
+    if (!traceFilename.empty()) pl0cc::trace::enable();
+    if (printMemoryReport || !memoryReportJsonFilename.empty()) pl0cc::memory::enable();
 
-    clog << "pl0cc completed with ";
-    if (lexer.errorCount() == 0) {
-        pl0cc::Syntax st = pl0cc::genSyntax();
-        std::optional<pl0cc::SyntaxTree> optTree;
-        try {
-            optTree = pl0cc::llZeroParseSyntax(st, ts);
-        } catch (std::tuple<int, int, int> err) {
-            clog << "Syntax parser reported an " << CONSOLE_RED << "error" << CONSOLE_RESET << " at line " << (std::get<1>(err)+1) << " token " << (std::get<2>(err)+1) << "." << endl;
-            clog << "---------------------" << std::endl;
-            clog << std::get<1>(err)+1 << " |\t" << lexer.sourceLine(std::get<1>(err)) << std::endl;
-            return EXIT_FAILURE;
-        }
+    clog << "pl0cc v0.1\n";
+
+    using Phase = pl0cc::TimeReport::Phase;
+    std::optional<pl0cc::TimeReport> timeReport;
+    if (printTimeReport || !timeReportJsonFilename.empty()) timeReport.emplace();
+    pl0cc::TimeReport* report = timeReport ? &*timeReport : nullptr;
 
-        clog << CONSOLE_GREEN << "0" << CONSOLE_RESET << " errors occurred." << endl;
+    // Build the lazily initialized tables up front instead of in the first worker
+    pl0cc::TimeReport::Timer automatonTimer(report, Phase::AUTOMATON);
+    pl0cc::memory::PhaseScope automatonPhase(pl0cc::memory::Phase::AUTOMATON);
+    const pl0cc::DeterministicAutomaton& dfa = Lexer::getDFA(keywordMatching(options));
+    automatonPhase.leave();
+    automatonTimer.stop();
+    pl0cc::symbols::symbolToNameMap();
+    if (report) report->count(pl0cc::TimeReport::Counter::DFA_STATES, dfa.stateCount());
 
-        ofstream output(outputFilename);
-        ts.serializeTo(output);
+    if (showAutomaton) {
+        clog << "Automaton >--------------\n";
+        clog << dfa.serialize() << '\n';
+    }
 
-        output << "Syntax Tree:\n";
-        optTree.value().serializeTo(output, pl0cc::symbols::symbolToName);
+    pl0cc::TimeReport::Timer grammarTimer(report, Phase::GRAMMAR);
+    pl0cc::memory::PhaseScope tablesPhase(pl0cc::memory::Phase::TABLES);
+    SharedTables tables{pl0cc::genSyntax(), {}, std::nullopt, std::nullopt, std::nullopt};
+    tables.llMap = tables.syntax.llMap();
+    grammarTimer.stop();
+    pl0cc::TimeReport::Timer parseTablesTimer(report, Phase::PARSE_TABLES);
+    if (options.flatExpressions) tables.exprTable = pl0cc::genOperatorTable(tables.syntax);
+    if (options.useLalr) tables.lalrTable.emplace(pl0cc::genLrSyntax());
+    parseTablesTimer.stop();
+    tablesPhase.leave();
+    tables.timeReport = report;
+    if (!cacheDirectory.empty()) {
+        try {
+            tables.cache.emplace(cacheDirectory, cacheVersion(), cacheLimit);
+        } catch (const std::runtime_error& e) {
+            clog << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": " << e.what() << "." << endl;
+            return EXIT_FAILURE;
+        }
+    }
 
-        output << flush;
-        output.close();
+    int status;
+    if (inputFilenames.size() == 1) {
+        status = compileFile(inputFilenames[0], outputFilenames[0], options, tables, clog);
     } else {
-        clog << CONSOLE_RED << lexer.errorCount() << CONSOLE_RESET << " lexer errors occurred." << endl;
-        clog << endl;
-        for (size_t i=0; i<lexer.errorCount(); i++) {
-            Lexer::ErrorReport report = lexer.errorReportAt(i);
+        pl0cc::WorkStealingPool pool(jobs);
+        status = compileAll(inputFilenames, outputFilenames, options, tables, pool, clog);
+    }
 
-            string srcFile = absoluteInputPath.string() + ":" + to_string(report.lineNumber() + 1) + ":" + to_string(report.columnNumber() + 1);
-            clog << "Error " << (i+1) << " at " << srcFile << ": " << std::endl;
-            report.reportErrorTo(clog);
+    if (timeReport) {
+        timeReport->finish();
+        if (printTimeReport) timeReport->printTo(clog);
+        if (!timeReportJsonFilename.empty()) {
+            ofstream json(timeReportJsonFilename);
+            json << timeReport->toJson().serialize() << '\n';
+            if (!json) {
+                clog << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Cannot write " << timeReportJsonFilename << "." << endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    if (printMemoryReport) pl0cc::memory::printReport(clog);
+    if (!memoryReportJsonFilename.empty()) {
+        ofstream json(memoryReportJsonFilename);
+        json << pl0cc::memory::reportJson().serialize() << '\n';
+        if (!json) {
+            clog << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Cannot write " << memoryReportJsonFilename << "." << endl;
+            return EXIT_FAILURE;
         }
+    }
+    if (!traceFilename.empty() && !pl0cc::trace::writeTo(traceFilename)) {
+        clog << "pl0cc: " << CONSOLE_RED << "Error" << CONSOLE_RESET << ": Cannot write " << traceFilename << "." << endl;
         return EXIT_FAILURE;
     }
-
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+    return status;
+}
@@ -0,0 +1,107 @@
+#include "memory_report.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iomanip>
+
+using namespace pl0cc;
+using memory::Phase;
+
+namespace {
+    constexpr const char* phaseNames[] {
+        "other", "automaton", "tables", "read", "lex", "intern", "parse", "output"
+    };
+
+    struct PhaseCounters {
+        std::atomic<std::uint64_t> allocations {0};
+        std::atomic<std::uint64_t> allocatedBytes {0};
+        std::atomic<std::uint64_t> releases {0};
+        std::atomic<std::uint64_t> releasedBytes {0};
+        std::atomic<std::int64_t> peakLiveBytes {0};
+    };
+
+    std::array<PhaseCounters, size_t(Phase::COUNT)> counters;
+    // Blocks from before enable() may be released later, so this can dip below zero
+    std::atomic<std::int64_t> liveBytes {0};
+    std::atomic<std::int64_t> peakLiveBytes {0};
+    thread_local Phase currentPhase = Phase::OTHER;
+
+    void raise(std::atomic<std::int64_t>& peak, std::int64_t value) {
+        std::int64_t seen = peak.load(std::memory_order_relaxed);
+        while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+    }
+
+    double mebibytes(std::uint64_t bytes) {
+        return double(bytes) / double(1 << 20);
+    }
+}
+
+memory::PhaseScope::PhaseScope(Phase phase) : previous(currentPhase), left(false) {
+    currentPhase = phase;
+}
+
+void memory::PhaseScope::leave() {
+    if (!left) currentPhase = previous;
+    left = true;
+}
+
+void memory::enable() {
+    counting = true;
+}
+
+void memory::noteAllocation(size_t bytes) {
+    PhaseCounters& phase = counters[size_t(currentPhase)];
+    phase.allocations.fetch_add(1, std::memory_order_relaxed);
+    phase.allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    std::int64_t live = liveBytes.fetch_add(std::int64_t(bytes), std::memory_order_relaxed) + std::int64_t(bytes);
+    raise(phase.peakLiveBytes, live);
+    raise(peakLiveBytes, live);
+}
+
+void memory::noteRelease(size_t bytes) {
+    PhaseCounters& phase = counters[size_t(currentPhase)];
+    phase.releases.fetch_add(1, std::memory_order_relaxed);
+    phase.releasedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    liveBytes.fetch_sub(std::int64_t(bytes), std::memory_order_relaxed);
+}
+
+void memory::printReport(std::ostream& os) {
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(2);
+    os << "Memory report >-------------\n";
+    os << "Phase          Allocations  Alloc (MiB)     Releases  Peak live (MiB)\n";
+    std::uint64_t totalAllocations = 0, totalBytes = 0, totalReleases = 0;
+    for (size_t i = 0; i < size_t(Phase::COUNT); i++) {
+        const PhaseCounters& phase = counters[i];
+        totalAllocations += phase.allocations;
+        totalBytes += phase.allocatedBytes;
+        totalReleases += phase.releases;
+        os << std::left << std::setw(14) << phaseNames[i] << std::right
+           << std::setw(12) << phase.allocations
+           << std::setw(13) << mebibytes(phase.allocatedBytes)
+           << std::setw(13) << phase.releases
+           << std::setw(17) << mebibytes(std::uint64_t(std::max<std::int64_t>(phase.peakLiveBytes, 0))) << '\n';
+    }
+    os << std::left << std::setw(14) << "total" << std::right
+       << std::setw(12) << totalAllocations
+       << std::setw(13) << mebibytes(totalBytes)
+       << std::setw(13) << totalReleases
+       << std::setw(17) << mebibytes(std::uint64_t(std::max<std::int64_t>(peakLiveBytes, 0))) << '\n';
+    os.flags(flags);
+}
+
+JsonValue memory::reportJson() {
+    JsonValue report;
+    for (size_t i = 0; i < size_t(Phase::COUNT); i++) {
+        const PhaseCounters& phase = counters[i];
+        JsonValue& entry = report["phases"][phaseNames[i]];
+        entry["allocations"] = phase.allocations.load();
+        entry["allocated_bytes"] = phase.allocatedBytes.load();
+        entry["releases"] = phase.releases.load();
+        entry["released_bytes"] = phase.releasedBytes.load();
+        entry["peak_live_bytes"] = std::max<std::int64_t>(phase.peakLiveBytes, 0);
+    }
+    report["peak_live_bytes"] = std::max<std::int64_t>(peakLiveBytes, 0);
+    return report;
+}
@@ -0,0 +1,49 @@
+#ifndef PL0CC_MEMORY_REPORT_HPP
+#define PL0CC_MEMORY_REPORT_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+
+#include "json.hpp"
+
+/*
+ * Heap accounting for --mem-report. The replaced global operator new and delete in
+ * allocation_hooks.cpp, which only the pl0cc executable links, report every block here once
+ * enable() has run; each allocation and release counts for the phase that is active on the
+ * allocating or releasing thread. Peak live bytes are the highest total of live heap bytes
+ * the whole process reached while a phase was allocating.
+ */
+namespace pl0cc::memory {
+    enum class Phase {
+        OTHER, AUTOMATON, TABLES, READ, LEX, INTERN, PARSE, OUTPUT, COUNT
+    };
+
+    inline std::atomic<bool> counting {false};
+
+    // Makes phase the current phase of this thread until leave() or destruction
+    class PhaseScope {
+    public:
+        explicit PhaseScope(Phase phase);
+        ~PhaseScope() { leave(); }
+
+        PhaseScope(const PhaseScope&) = delete;
+        PhaseScope& operator=(const PhaseScope&) = delete;
+
+        void leave();
+    private:
+        Phase previous;
+        bool left;
+    };
+
+    void enable();
+
+    // Called by the allocation hooks; neither allocates
+    void noteAllocation(size_t bytes);
+    void noteRelease(size_t bytes);
+
+    void printReport(std::ostream& os);
+    JsonValue reportJson();
+}
+
+#endif // PL0CC_MEMORY_REPORT_HPP
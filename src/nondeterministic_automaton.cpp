@@ -247,7 +247,7 @@ static std::string serializeSet(const std::set<T>& val) {
     return serializeStream.str();
 }
 
-DeterministicAutomaton NondeterministicAutomaton::toDeterministic() const {
+DeterministicAutomaton NondeterministicAutomaton::toDeterministic(bool simplified) const {
     const NondeterministicAutomaton &nfa = *this;
 
     DeterministicAutomaton atm;
@@ -287,7 +287,7 @@ DeterministicAutomaton NondeterministicAutomaton::toDeterministic() const {
         }
     }
 
-    atm.simplify();
+    if (simplified) atm.simplify();
 
     return atm;
 }
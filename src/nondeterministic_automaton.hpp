@@ -83,7 +83,8 @@ namespace pl0cc {
 
         [[nodiscard]] std::string serialize() const;
 
-        [[nodiscard]] DeterministicAutomaton toDeterministic() const;
+        // Subset construction; the result is minimized with simplify() unless simplified is false
+        [[nodiscard]] DeterministicAutomaton toDeterministic(bool simplified = true) const;
     private:
         struct state_node {
             std::multimap<EncodeUnit, SingleState> next;
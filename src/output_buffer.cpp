@@ -0,0 +1,145 @@
+#include "output_buffer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+using namespace pl0cc;
+
+namespace {
+    // The buffer of the last OutputBuffer that ended on this thread
+    thread_local std::vector<char> spareBuffer;
+
+    constexpr char DIGIT_PAIRS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    constexpr char SPACES[] = "                                                                ";
+
+    // Writes value so that it ends right before end; returns where it starts
+    char* formatUnsigned(unsigned long long value, char* end) {
+        while (value >= 100) {
+            const char* pair = DIGIT_PAIRS + (value % 100) * 2;
+            value /= 100;
+            *--end = pair[1];
+            *--end = pair[0];
+        }
+        if (value >= 10) {
+            const char* pair = DIGIT_PAIRS + value * 2;
+            *--end = pair[1];
+            *--end = pair[0];
+        } else {
+            *--end = char('0' + value);
+        }
+        return end;
+    }
+}
+
+OutputBuffer::OutputBuffer(int fd) : fd(fd), os(nullptr), buffer(), pos(nullptr), limit(nullptr), error(false) {
+    buffer.swap(spareBuffer);
+    buffer.resize(CAPACITY);
+    pos = buffer.data();
+    limit = buffer.data() + buffer.size();
+}
+
+OutputBuffer::OutputBuffer(std::ostream& os) : OutputBuffer(-1) {
+    this->os = &os;
+}
+
+OutputBuffer::~OutputBuffer() {
+    flush();
+    buffer.swap(spareBuffer);
+}
+
+void OutputBuffer::put(std::string_view s) {
+    if (s.size() > size_t(limit - pos)) {
+        drain();
+        // Too large to be worth copying
+        if (s.size() > buffer.size()) {
+            writeOut(s.data(), s.size());
+            return;
+        }
+    }
+    std::memcpy(pos, s.data(), s.size());
+    pos += s.size();
+}
+
+void OutputBuffer::putUnsigned(unsigned long long value) {
+    reserve(20);
+    char digits[20];
+    char* start = formatUnsigned(value, digits + sizeof digits);
+    size_t length = size_t(digits + sizeof digits - start);
+    std::memcpy(pos, start, length);
+    pos += length;
+}
+
+void OutputBuffer::putInt(long long value) {
+    if (value < 0) {
+        put('-');
+        putUnsigned(0ull - static_cast<unsigned long long>(value));
+    } else {
+        putUnsigned(static_cast<unsigned long long>(value));
+    }
+}
+
+void OutputBuffer::putRepeated(char c, size_t count) {
+    while (count > 0) {
+        if (pos == limit) drain();
+        size_t chunk = std::min(count, size_t(limit - pos));
+        std::memset(pos, c, chunk);
+        pos += chunk;
+        count -= chunk;
+    }
+}
+
+void OutputBuffer::putPadded(std::string_view s, size_t width) {
+    put(s);
+    if (s.size() >= width) return;
+    size_t padding = width - s.size();
+    if (padding < sizeof SPACES) {
+        put(std::string_view(SPACES, padding));
+    } else {
+        putRepeated(' ', padding);
+    }
+}
+
+void OutputBuffer::putUnsignedPadded(unsigned long long value, size_t width) {
+    char digits[20];
+    char* start = formatUnsigned(value, digits + sizeof digits);
+    putPadded(std::string_view(start, size_t(digits + sizeof digits - start)), width);
+}
+
+bool OutputBuffer::flush() {
+    drain();
+    if (os != nullptr) os->flush();
+    return !error;
+}
+
+void OutputBuffer::drain() {
+    size_t size = size_t(pos - buffer.data());
+    pos = buffer.data();
+    writeOut(buffer.data(), size);
+}
+
+void OutputBuffer::writeOut(const char* data, size_t size) {
+    if (size == 0 || error) return;
+
+    if (os != nullptr) {
+        os->write(data, std::streamsize(size));
+        if (!*os) error = true;
+        return;
+    }
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            error = true;
+            return;
+        }
+        data += written;
+        size -= size_t(written);
+    }
+}
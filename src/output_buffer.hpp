@@ -0,0 +1,59 @@
+#ifndef PL0CC_OUTPUT_BUFFER_HPP
+#define PL0CC_OUTPUT_BUFFER_HPP
+
+#include <cstddef>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace pl0cc {
+    /*
+     * Formatting buffer for the large text outputs. Text collects in one big buffer, which the
+     * thread keeps for its next OutputBuffer, and leaves in large write(2) calls, or through an
+     * ostream for callers that only have one. Integers are formatted by hand and padding is
+     * copied from a run of spaces, so nothing allocates per line.
+     */
+    class OutputBuffer {
+    public:
+        static constexpr size_t CAPACITY = size_t(1) << 20;
+
+        explicit OutputBuffer(int fd);
+        explicit OutputBuffer(std::ostream& os);
+        // Flushes; a failure there is only visible through failed()
+        ~OutputBuffer();
+
+        OutputBuffer(const OutputBuffer&) = delete;
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+        void put(char c) {
+            if (pos == limit) drain();
+            *pos++ = c;
+        }
+        void put(std::string_view s);
+        void putUnsigned(unsigned long long value);
+        void putInt(long long value);
+        void putRepeated(char c, size_t count);
+        // Writes s, then spaces up to width; wider text is not cut
+        void putPadded(std::string_view s, size_t width);
+        void putUnsignedPadded(unsigned long long value, size_t width);
+
+        // false once any write has failed
+        bool flush();
+        [[nodiscard]] bool failed() const { return error; }
+    private:
+        int fd;
+        std::ostream* os;
+        std::vector<char> buffer;
+        char* pos;
+        char* limit;
+        bool error;
+
+        void drain();
+        void writeOut(const char* data, size_t size);
+        void reserve(size_t count) {
+            if (size_t(limit - pos) < count) drain();
+        }
+    };
+}
+
+#endif // PL0CC_OUTPUT_BUFFER_HPP
@@ -0,0 +1,130 @@
+#include "rd_codegen.hpp"
+
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace pl0cc;
+
+namespace {
+    std::string symbolName(Symbol s) {
+        const auto& smap = symbols::symbolToNameMap();
+        if (smap.count(s)) return smap.at(s);
+        return "SYMBOL" + std::to_string(s);
+    }
+
+    std::string tokenCase(Symbol s) {
+        // End of input appears as EPS in the select sets
+        if (s == EPS) s = Symbol(TokenType::TOKEN_EOF);
+        return "case TokenType(" + std::to_string(s) + "): /* " + tokenTypeName(TokenType(s)) + " */";
+    }
+
+    void generateFunction(const Syntax& syntax, Symbol s, const std::map<Symbol, Sentence>& row, std::ostream& os) {
+        const auto& ntSymbols = syntax.nonTerminatingSymbols();
+
+        // Group lookahead tokens by the conduct they select, in conduct order
+        std::vector<std::pair<Sentence, std::set<Symbol>>> branches;
+        for (const auto& [conductLeft, conductRight] : syntax.conducts()) {
+            if (conductLeft != s) continue;
+            std::set<Symbol> lookaheads;
+            for (const auto& [token, sentence] : row) {
+                if (sentence == conductRight) lookaheads.insert(token);
+            }
+            if (!lookaheads.empty()) branches.emplace_back(conductRight, lookaheads);
+        }
+
+        bool tailLoop = false;
+        for (const auto& [sentence, _] : branches) {
+            if (sentence.size() > 0 && sentence[sentence.size() - 1] == s) tailLoop = true;
+        }
+
+        const std::string indent = tailLoop ? "                " : "            ";
+        os << "        void parse_" << symbolName(s) << "() {\n";
+        if (tailLoop) {
+            os << "            size_t depth = 0;\n";
+            os << "            while (true) {\n";
+        }
+        os << indent << "sink.enter(Symbol(" << s << "u));\n";
+        os << indent << "switch (lookahead()) {\n";
+        for (const auto& [sentence, lookaheads] : branches) {
+            for (Symbol token : lookaheads) {
+                os << indent << "    " << tokenCase(token) << '\n';
+            }
+            bool selfTail = tailLoop && sentence.size() > 0 && sentence[sentence.size() - 1] == s;
+            size_t callCount = selfTail ? sentence.size() - 1 : sentence.size();
+            for (size_t i = 0; i < callCount; i++) {
+                if (ntSymbols.count(sentence[i])) {
+                    os << indent << "        parse_" << symbolName(sentence[i]) << "();\n";
+                } else {
+                    os << indent << "        expect(TokenType(" << sentence[i] << ")); // "
+                       << tokenTypeName(TokenType(sentence[i])) << '\n';
+                }
+            }
+            if (selfTail) {
+                os << indent << "        depth++;\n";
+                os << indent << "        continue;\n";
+            } else {
+                os << indent << "        break;\n";
+            }
+        }
+        os << indent << "    default:\n";
+        os << indent << "        fail();\n";
+        os << indent << "}\n";
+        if (tailLoop) {
+            os << "                break;\n";
+            os << "            }\n";
+            os << "            for (size_t i = 0; i <= depth; i++) sink.exit(Symbol(" << s << "u));\n";
+        } else {
+            os << "            sink.exit(Symbol(" << s << "u));\n";
+        }
+        os << "        }\n\n";
+    }
+}
+
+void pl0cc::generateRecursiveDescentParser(const Syntax& syntax, std::ostream& os, const std::string& className) {
+    const auto llMap = syntax.llMap();
+
+    os << "// Generated by pl0cc_rdgen. Do not edit.\n";
+    os << "#include <tuple>\n\n";
+    os << "#include \"lexer.hpp\"\n";
+    os << "#include \"syntax.hpp\"\n\n";
+    os << "namespace pl0cc::generated {\n";
+    os << "    template <typename Sink>\n";
+    os << "    class " << className << " {\n";
+    os << "    public:\n";
+    os << "        " << className << "(const TokenStorage& ts, Sink& sink) :\n";
+    os << "            ts(ts), sink(sink), tokenIter(ts.begin()), lineCounter(0), tokenCounter(0) {}\n\n";
+    os << "        void parse() {\n";
+    os << "            parse_" << symbolName(syntax.start()) << "();\n";
+    os << "        }\n";
+    os << "    private:\n";
+    os << "        const TokenStorage& ts;\n";
+    os << "        Sink& sink;\n";
+    os << "        std::vector<Token>::const_iterator tokenIter;\n";
+    os << "        int lineCounter, tokenCounter;\n\n";
+    os << "        TokenType lookahead() {\n";
+    os << "            while (tokenIter->type == TokenType::NEWLINE) {\n";
+    os << "                tokenIter++;\n";
+    os << "                lineCounter++;\n";
+    os << "                tokenCounter = 0;\n";
+    os << "            }\n";
+    os << "            return tokenIter->type;\n";
+    os << "        }\n\n";
+    os << "        [[noreturn]] void fail() {\n";
+    os << "            throw std::tuple<int, int, int>(tokenIter - ts.begin(), lineCounter, tokenCounter);\n";
+    os << "        }\n\n";
+    os << "        void expect(TokenType type) {\n";
+    os << "            if (lookahead() != type) fail();\n";
+    os << "            sink.token(*tokenIter, size_t(tokenIter - ts.begin()));\n";
+    os << "            tokenIter++;\n";
+    os << "            tokenCounter++;\n";
+    os << "        }\n\n";
+
+    for (Symbol s : syntax.nonTerminatingSymbols()) {
+        auto row = llMap.find(s);
+        generateFunction(syntax, s, row == llMap.end() ? std::map<Symbol, Sentence>() : row->second, os);
+    }
+
+    os << "    };\n";
+    os << "}\n";
+}
@@ -0,0 +1,26 @@
+#ifndef PL0CC_RD_CODEGEN_HPP
+#define PL0CC_RD_CODEGEN_HPP
+
+#include <ostream>
+#include <string>
+
+#include "syntax.hpp"
+
+namespace pl0cc {
+    /*
+     * Emits a C++ header with a recursive-descent parser specialized for the LL(1) table of syntax:
+     *
+     *   template <typename Sink> class <className> {
+     *       <className>(const TokenStorage& ts, Sink& sink);
+     *       void parse();
+     *   };
+     *
+     * There is one member function per non-terminating symbol, switching on the lookahead token
+     * with the cases taken from the select sets. Events are reported to the sink like
+     * llZeroParseEvents(), and errors are thrown as the same std::tuple<int, int, int>.
+     * Self-recursion in the tail position of a conduct is emitted as a loop.
+     */
+    void generateRecursiveDescentParser(const Syntax& syntax, std::ostream& os, const std::string& className);
+}
+
+#endif // PL0CC_RD_CODEGEN_HPP
@@ -0,0 +1,15 @@
+#include "rd_parser.hpp"
+#include "rd_parser.gen.hpp"
+
+using namespace pl0cc;
+
+SyntaxTree pl0cc::rdParseSyntax(const TokenStorage& ts) {
+    SyntaxTreeBuilder builder;
+    generated::RecursiveDescentParser<SyntaxTreeBuilder>(ts, builder).parse();
+    return builder.result();
+}
+
+void pl0cc::rdCheckSyntax(const TokenStorage& ts) {
+    NullParseSink sink;
+    generated::RecursiveDescentParser<NullParseSink>(ts, sink).parse();
+}
@@ -0,0 +1,14 @@
+#ifndef PL0CC_RD_PARSER_HPP
+#define PL0CC_RD_PARSER_HPP
+
+#include "lexer.hpp"
+#include "syntax.hpp"
+
+namespace pl0cc {
+    // Recursive-descent parser generated from genSyntax() by pl0cc_rdgen at build time.
+    // Produces the same tree as llZeroParseSyntax(genSyntax(), ts) and throws the same errors.
+    SyntaxTree rdParseSyntax(const TokenStorage& ts);
+    void rdCheckSyntax(const TokenStorage& ts);
+}
+
+#endif // PL0CC_RD_PARSER_HPP
@@ -7,7 +7,8 @@ namespace pl0cc {
     Regex::Regex(std::string_view sv) :
             _tokens(regexTokenize(sv)),
             _atm(buildNfa(_tokens)),
-            _dfaPtr(nullptr)
+            _dfaPtr(nullptr),
+            _dfaBuilt()
     {}
 
     bool Regex::match(std::string_view sv) const {
@@ -43,9 +44,9 @@ namespace pl0cc {
     }
 
     void Regex::makeDfa() const {
-        if (_dfaPtr == nullptr) {
+        std::call_once(_dfaBuilt, [this] {
             _dfaPtr = std::make_unique<DeterministicAutomaton>(_atm.toDeterministic());
-        }
+        });
     }
 
     Regex literal::operator"" _regex(const char* str, size_t len) {
@@ -2,6 +2,7 @@
 #define PL0CC_REGEX_HPP
 
 #include <memory>
+#include <mutex>
 #include <string_view>
 #include <vector>
 
@@ -18,11 +19,13 @@ namespace pl0cc {
         std::vector<std::string> tokens() const;
         NondeterministicAutomaton& automaton();
         const NondeterministicAutomaton& automaton() const;
+        // Built by the first match() or deterministicAutomaton(), once even across threads
         const DeterministicAutomaton& deterministicAutomaton() const;
     private:
         std::vector<std::shared_ptr<RegexToken>> _tokens;
         NondeterministicAutomaton _atm;
         mutable std::unique_ptr<DeterministicAutomaton> _dfaPtr;
+        mutable std::once_flag _dfaBuilt;
 
         void makeDfa() const;
     };
@@ -0,0 +1,148 @@
+#include "string_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+using namespace pl0cc;
+
+namespace {
+    constexpr size_t BLOCK_SIZE = size_t(64) << 10;
+    constexpr size_t PREFIX = sizeof(std::uint32_t);
+    constexpr std::string_view ESCAPED_QUOTE = "\\\"";
+
+    std::uint64_t hashOf(std::string_view value) {
+        return std::hash<std::string_view>()(value);
+    }
+
+    bool quoted(std::string_view spelling) {
+        return spelling.size() >= 2 && spelling.front() == '"' && spelling.back() == '"';
+    }
+
+    std::string_view unquoted(std::string_view spelling) {
+        return quoted(spelling) ? spelling.substr(1, spelling.size() - 2) : spelling;
+    }
+
+    std::string_view readPrefixed(const char* at) {
+        std::uint32_t length;
+        std::memcpy(&length, at, PREFIX);
+        return {at + PREFIX, length};
+    }
+
+    char* writePrefix(char* at, size_t length) {
+        auto prefix = std::uint32_t(length);
+        std::memcpy(at, &prefix, PREFIX);
+        return at + PREFIX;
+    }
+
+    char* storePrefixed(char* at, std::string_view bytes) {
+        char* out = writePrefix(at, bytes.size());
+        std::memcpy(out, bytes.data(), bytes.size());
+        return out + bytes.size();
+    }
+}
+
+void StringPool::attachSource(const std::string* source) {
+    detachSource();
+    this->source = source;
+}
+
+void StringPool::detachSource() {
+    for (Entry& entry : entries) {
+        if (entry.stored != nullptr) continue;
+        std::string_view bytes = std::string_view(*source).substr(entry.sourceOffset, entry.sourceLength);
+        char* at = reserve(PREFIX + bytes.size());
+        commit(storePrefixed(at, bytes));
+        entry.stored = at;
+    }
+    source = nullptr;
+}
+
+int StringPool::intern(std::string_view spelling, size_t sourceOffset) {
+    std::string_view inner = unquoted(spelling);
+    if (inner.find(ESCAPED_QUOTE) == std::string_view::npos) {
+        std::uint64_t hash = hashOf(inner);
+        int found = find(hash, inner);
+        if (found >= 0) return found;
+        Entry entry {hash, nullptr, sourceOffset, std::uint32_t(spelling.size()), false};
+        if (source == nullptr || sourceOffset == NOT_IN_SOURCE) {
+            char* at = reserve(PREFIX + spelling.size());
+            commit(storePrefixed(at, spelling));
+            entry.stored = at;
+        }
+        return insert(entry);
+    }
+
+    // Decodes into the arena first; the bytes are only kept if the value is new
+    char* at = reserve(2 * PREFIX + inner.size() + spelling.size());
+    char* out = at + PREFIX;
+    for (size_t i = 0; i < inner.size(); i++) {
+        if (inner.compare(i, ESCAPED_QUOTE.size(), ESCAPED_QUOTE) == 0) i++;
+        *out++ = inner[i];
+    }
+    std::string_view value(at + PREFIX, size_t(out - at) - PREFIX);
+    std::uint64_t hash = hashOf(value);
+    int found = find(hash, value);
+    if (found >= 0) return found;
+    writePrefix(at, value.size());
+    commit(storePrefixed(out, spelling));
+    return insert(Entry {hash, at, NOT_IN_SOURCE, 0, true});
+}
+
+std::string_view StringPool::value(size_t index) const {
+    const Entry& entry = entries[index];
+    if (entry.escaped) return readPrefixed(entry.stored);
+    return unquoted(spelling(index));
+}
+
+std::string_view StringPool::spelling(size_t index) const {
+    const Entry& entry = entries[index];
+    if (entry.stored == nullptr) return std::string_view(*source).substr(entry.sourceOffset, entry.sourceLength);
+    if (!entry.escaped) return readPrefixed(entry.stored);
+    std::string_view value = readPrefixed(entry.stored);
+    return readPrefixed(value.data() + value.size());
+}
+
+int StringPool::find(std::uint64_t hash, std::string_view value) const {
+    if (slots.empty()) return -1;
+    const size_t mask = slots.size() - 1;
+    for (size_t i = size_t(hash) & mask; slots[i] != 0; i = (i + 1) & mask) {
+        size_t index = slots[i] - 1;
+        if (entries[index].hash == hash && this->value(index) == value) return int(index);
+    }
+    return -1;
+}
+
+int StringPool::insert(const Entry& entry) {
+    entries.push_back(entry);
+    // At most three quarters full; growing rehashes from the stored hashes alone
+    if (entries.size() * 4 > slots.size() * 3) {
+        slots.assign(std::max<size_t>(slots.size() * 2, 16), 0);
+        for (size_t index = 0; index < entries.size(); index++) place(index);
+    } else {
+        place(entries.size() - 1);
+    }
+    return int(entries.size() - 1);
+}
+
+void StringPool::place(size_t index) {
+    const size_t mask = slots.size() - 1;
+    size_t i = size_t(entries[index].hash) & mask;
+    while (slots[i] != 0) i = (i + 1) & mask;
+    slots[i] = std::uint32_t(index + 1);
+}
+
+char* StringPool::reserve(size_t length) {
+    if (length > room) {
+        size_t size = std::max(BLOCK_SIZE, length);
+        blocks.emplace_back(new char[size]);
+        free = blocks.back().get();
+        room = size;
+    }
+    return free;
+}
+
+void StringPool::commit(char* end) {
+    room -= size_t(end - free);
+    free = end;
+}
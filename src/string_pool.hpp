@@ -0,0 +1,62 @@
+#ifndef PL0CC_STRING_POOL_HPP
+#define PL0CC_STRING_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pl0cc {
+    /*
+     * Interned STRING literals, one entry per decoded value. A literal without escapes that
+     * lies in the attached source stays a view of it and is never copied. The others are
+     * decoded straight into an arena of length-prefixed bytes: the spelling, preceded by the
+     * value when escapes make the two differ. Every entry keeps the hash of its value, so
+     * neither lookups nor table growth hash its bytes again.
+     */
+    class StringPool {
+    public:
+        static constexpr size_t NOT_IN_SOURCE = size_t(-1);
+
+        // Literals interned with a source offset are viewed from *source, which may only grow
+        void attachSource(const std::string* source);
+        // Copies the entries viewed from the source into the arena, before the source changes
+        void detachSource();
+
+        // Index of the value of spelling, a literal with its quotes at sourceOffset of the source
+        int intern(std::string_view spelling, size_t sourceOffset = NOT_IN_SOURCE);
+
+        [[nodiscard]] size_t size() const { return entries.size(); }
+        // The literal with its escapes resolved
+        [[nodiscard]] std::string_view value(size_t index) const;
+        // The literal as first written, quotes included
+        [[nodiscard]] std::string_view spelling(size_t index) const;
+        [[nodiscard]] std::uint64_t hash(size_t index) const { return entries[index].hash; }
+    private:
+        struct Entry {
+            std::uint64_t hash;
+            const char* stored;     // Arena bytes, or null for a view of the source
+            size_t sourceOffset;    // Of the spelling, for a view
+            std::uint32_t sourceLength;
+            bool escaped;           // stored holds the value before the spelling
+        };
+
+        const std::string* source = nullptr;
+        std::vector<Entry> entries;
+        std::vector<std::uint32_t> slots;   // Open addressing over entries: index + 1, or 0 if free
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char* free = nullptr;
+        size_t room = 0;
+
+        [[nodiscard]] int find(std::uint64_t hash, std::string_view value) const;
+        int insert(const Entry& entry);
+        void place(size_t index);
+        // Room for length bytes at free; commit() keeps the bytes written up to end
+        char* reserve(size_t length);
+        void commit(char* end);
+    };
+}
+
+#endif // PL0CC_STRING_POOL_HPP
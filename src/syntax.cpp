@@ -1,5 +1,7 @@
 #include "syntax.hpp"
 #include "lexer.hpp"
+#include "output_buffer.hpp"
+#include "trace.hpp"
 #include <cassert>
 #include <cmath>
 #include <memory>
@@ -7,11 +9,14 @@
 #include <set>
 #include <stack>
 #include <tuple>
+#include <unordered_map>
 #include <unordered_set>
 
 using namespace pl0cc;
 
 namespace {
+    const std::set<Symbol> noSymbols;
+
     template <typename T>
     void mergeSet(std::set<T>& s1, const std::set<T>& s2) {
         s1.insert(s2.begin(), s2.end());
@@ -30,9 +35,26 @@ namespace {
     }
 }
 
+Syntax::Syntax(const Syntax& other) :
+    startSymbol(other.startSymbol), symbolSet(other.symbolSet), ntSymbolSet(other.ntSymbolSet),
+    sentences(other.sentences), conductVector(other.conductVector),
+    emptySymbolSetValid(false), firstSetsValid(false), followSetsValid(false) {}
+
+Syntax& Syntax::operator=(const Syntax& other) {
+    if (this == &other) return *this;
+    startSymbol = other.startSymbol;
+    symbolSet = other.symbolSet;
+    ntSymbolSet = other.ntSymbolSet;
+    sentences = other.sentences;
+    conductVector = other.conductVector;
+    emptySymbolSetValid = firstSetsValid = followSetsValid = false;
+    return *this;
+}
+
 void Syntax::addConduct(Symbol leftPart, Sentence rightPart) {
     firstSetsValid = false;
     emptySymbolSetValid = false;
+    followSetsValid = false;
 
     addSymbol(leftPart);
     ntSymbolSet.insert(leftPart);
@@ -47,9 +69,11 @@ void Syntax::addConduct(Symbol leftPart, Sentence rightPart) {
 
 const std::set<Symbol>& Syntax::firstSet(Symbol s) const {
     if (!firstSetsValid) {
-        calculateFirstSet();
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (!firstSetsValid) calculateFirstSet();
     }
-    return firstSets[s];
+    auto it = firstSets.find(s);
+    return it == firstSets.end() ? noSymbols : it->second;
 }
 
 std::set<Symbol> Syntax::firstSet(const Sentence& stmt) const {
@@ -68,8 +92,12 @@ std::set<Symbol> Syntax::firstSet(const Sentence& stmt) const {
 }
 
 const std::set<Symbol>& Syntax::followSet(Symbol s) const {
-    if (!followSetsValid) calculateFollowSet();
-    return followSets[s];
+    if (!followSetsValid) {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (!followSetsValid) calculateFollowSet();
+    }
+    auto it = followSets.find(s);
+    return it == followSets.end() ? noSymbols : it->second;
 }
 
 std::set<Symbol> Syntax::selectSet(Symbol leftPart, const Sentence& rightPart) const {
@@ -82,6 +110,7 @@ std::set<Symbol> Syntax::selectSet(Symbol leftPart, const Sentence& rightPart) c
 }
 
 std::map<Symbol, std::map<Symbol, Sentence>> Syntax::llMap() const {
+    PL0CC_TRACE_SCOPE("ll_map");
     std::map<Symbol, std::map<Symbol, Sentence>> selectMap;
     for (auto [conductLeft, conductRight] : conducts()) {
         auto nextSymbols = selectSet(conductLeft, conductRight);
@@ -268,10 +297,24 @@ Symbol SyntaxTree::symbol() const {
     return symbolData;
 }
 
+const std::optional<Token>& SyntaxTree::token() const {
+    return tokenData;
+}
+
 void SyntaxTree::addChild(SyntaxTree st) {
     childs.push_back(std::make_shared<SyntaxTree>(std::move(st)));
 }
 
+void SyntaxTree::addChild(std::shared_ptr<SyntaxTree> st) {
+    childs.push_back(std::move(st));
+}
+
+std::shared_ptr<SyntaxTree> SyntaxTree::popChild() {
+    auto child = std::move(childs.back());
+    childs.pop_back();
+    return child;
+}
+
 size_t SyntaxTree::childCount() const {
     return childs.size();
 }
@@ -292,6 +335,10 @@ std::shared_ptr<SyntaxTree> SyntaxTree::shareChild(size_t index) {
     return childs[index];
 }
 
+void SyntaxTree::replaceChild(size_t index, std::shared_ptr<SyntaxTree> st) {
+    childs[index] = std::move(st);
+}
+
 void SyntaxTree::setChildSentence(const Sentence& sentence) {
     for (auto sym : sentence) {
         addChild(SyntaxTree(sym));
@@ -302,20 +349,44 @@ void SyntaxTree::setTokenData(Token token) {
     tokenData = token;
 }
 
-
-void SyntaxTree::serializeTo(std::ostream& os, std::function<std::string(Symbol)> symbolName, int tabCount) {
-    for (int i=0; i<tabCount; i++) {
-        os << "|";
-    }
-    os << symbolName(symbolData);
-    if (tokenData.has_value()) {
-        os << " with token seman " << tokenData->seman;
+size_t SyntaxTree::nodeCount() const {
+    size_t count = 1;
+    for (const auto& ch : childs) {
+        if (ch != nullptr) count += ch->nodeCount();
     }
-    os << '\n';
+    return count;
+}
+
+
+void SyntaxTree::serializeTo(std::ostream& os, std::function<std::string(Symbol)> symbolName, int tabCount) const {
+    OutputBuffer out(os);
+    serializeTo(out, symbolName, tabCount);
+}
 
-    for (auto ch : childs) {
-        if (ch == nullptr) continue;
-        ch->serializeTo(os, symbolName, tabCount+1);
+void SyntaxTree::serializeTo(OutputBuffer& out, const std::function<std::string(Symbol)>& symbolName, int tabCount) const {
+    PL0CC_TRACE_SCOPE("serialize_syntax_tree");
+    // Few distinct symbols against many nodes, so each name is looked up once
+    std::unordered_map<Symbol, std::string> names;
+    std::string bars;
+    std::vector<std::pair<const SyntaxTree*, size_t>> pending {{this, size_t(tabCount)}};
+    while (!pending.empty()) {
+        auto [node, depth] = pending.back();
+        pending.pop_back();
+
+        if (bars.size() < depth) bars.resize(depth, '|');
+        out.put(std::string_view(bars.data(), depth));
+        auto name = names.find(node->symbolData);
+        if (name == names.end()) name = names.emplace(node->symbolData, symbolName(node->symbolData)).first;
+        out.put(name->second);
+        if (node->tokenData.has_value()) {
+            out.put(" with token seman ");
+            out.putInt(node->tokenData->seman);
+        }
+        out.put('\n');
+
+        for (auto ch = node->childs.rbegin(); ch != node->childs.rend(); ++ch) {
+            if (*ch != nullptr) pending.emplace_back(ch->get(), depth + 1);
+        }
     }
 }
 
@@ -419,14 +490,77 @@ Syntax pl0cc::genSyntax() {
     return syn;
 }
 
-const std::map<Symbol, std::string>& pl0cc::symbols::symbolToNameMap() {
-    static std::map<Symbol, std::string> smap;
-    static bool edited = false;
+Syntax pl0cc::genLrSyntax() {
+    using namespace pl0cc::symbols;
 
-    if (edited) {
-        return smap;
+    // Conducts with right-recursive helpers that are rewritten below
+    const std::set<Symbol> rewritten {
+        L6_EXPR, L5_EXPR, L4_EXPR, L3_EXPR, L2_EXPR, L1_EXPR,
+        L6_EXPR_P, L5_EXPR_P, L4_EXPR_P, L3_EXPR_P, L2_EXPR_P, L1_EXPR_P,
+        STMTS, VIRTVARDEFS, VIRTVARDEFS_P, PROGRAM
+    };
+
+    const Syntax llSyntax = genSyntax();
+    Syntax syn(PROGRAM);
+    for (const auto& [conductLeft, conductRight] : llSyntax.conducts()) {
+        if (!rewritten.count(conductLeft)) syn.addConduct(conductLeft, conductRight);
     }
-#define SYMDEF(name, value) smap[value] = #name
+
+    syn.addConduct(L6_EXPR, {L7_EXPR});
+    syn.addConduct(L6_EXPR, {L6_EXPR, BI_OP6, L7_EXPR});
+    syn.addConduct(L5_EXPR, {L6_EXPR});
+    syn.addConduct(L5_EXPR, {L5_EXPR, BI_OP5, L6_EXPR});
+    syn.addConduct(L4_EXPR, {L5_EXPR});
+    syn.addConduct(L4_EXPR, {L4_EXPR, BI_OP4, L5_EXPR});
+    syn.addConduct(L3_EXPR, {L4_EXPR});
+    syn.addConduct(L3_EXPR, {L3_EXPR, BI_OP3, L4_EXPR});
+    // Assignment stays right associative
+    syn.addConduct(L2_EXPR, {L3_EXPR});
+    syn.addConduct(L2_EXPR, {L3_EXPR, BI_OP2, L2_EXPR});
+    syn.addConduct(L1_EXPR, {L2_EXPR});
+    syn.addConduct(L1_EXPR, {L1_EXPR, BI_OP1, L2_EXPR});
+
+    syn.addConduct(STMTS, {});
+    syn.addConduct(STMTS, {STMTS, STMT});
+
+    syn.addConduct(VIRTVARDEFS, {VARDEF});
+    syn.addConduct(VIRTVARDEFS, {VIRTVARDEFS, Symbol(TokenType::COMMA), VARDEF});
+
+    syn.addConduct(PROGRAM, {});
+    syn.addConduct(PROGRAM, {PROGRAM, PROGRAM_PART});
+    return syn;
+}
+
+OperatorPrecedenceTable::OperatorPrecedenceTable(Symbol expression, Symbol operand) :
+    exprSymbol(expression), operandSymbol(operand), entries() {}
+
+void OperatorPrecedenceTable::addOperator(Symbol op, int precedence, bool rightAssociative) {
+    if (op >= entries.size()) entries.resize(op + 1, Entry{0, false});
+    entries[op] = Entry{precedence, rightAssociative};
+}
+
+OperatorPrecedenceTable pl0cc::genOperatorTable(const Syntax& syntax) {
+    using namespace pl0cc::symbols;
+
+    // BI_OPn binds tighter as n grows, mirroring the L1_EXPR ... L6_EXPR cascade
+    const std::map<Symbol, int> levels {
+        {BI_OP1, 1}, {BI_OP2, 2}, {BI_OP3, 3}, {BI_OP4, 4}, {BI_OP5, 5}, {BI_OP6, 6}
+    };
+
+    OperatorPrecedenceTable table(EXPR, L7_EXPR);
+    for (const auto& [conductLeft, conductRight] : syntax.conducts()) {
+        if (!levels.count(conductLeft) || conductRight.size() != 1) continue;
+        // Assignment is the only right associative operator
+        table.addOperator(conductRight[0], levels.at(conductLeft), conductLeft == BI_OP2);
+    }
+    return table;
+}
+
+const std::map<Symbol, std::string>& pl0cc::symbols::symbolToNameMap() {
+    // Initialized once on first use, which C++ makes thread-safe for function-local statics
+    static const std::map<Symbol, std::string> smap = [] {
+        std::map<Symbol, std::string> names;
+#define SYMDEF(name, value) names[value] = #name
 
         SYMDEF(LITERAL,       256);
         SYMDEF(SINGLE_EXPR,   257);
@@ -466,10 +600,12 @@ const std::map<Symbol, std::string>& pl0cc::symbols::symbolToNameMap() {
         SYMDEF(BI_OP2,        294);
         SYMDEF(BI_OP1,        295);
         SYMDEF(TYPE,          296);
+        SYMDEF(BI_EXPR,       297);
 
 #undef SYMDEF
 
-    edited = true;
+        return names;
+    }();
     return smap;
 }
 
@@ -481,50 +617,53 @@ std::string pl0cc::symbols::symbolToName(Symbol s) {
     return tokenTypeName(static_cast<TokenType>(s));
 }
 
-// If exception throws token count
-SyntaxTree pl0cc::llZeroParseSyntax(const Syntax &syntax, const TokenStorage &ts) {
-    std::shared_ptr<SyntaxTree> stt = std::make_shared<SyntaxTree>(syntax.start());
-    
-    std::stack<std::shared_ptr<SyntaxTree>> symbolStack;
-    symbolStack.push(stt);
-
-
-    auto llMap = syntax.llMap();
-
-    auto tokenIter = ts.begin();
-    int lineCounter = 0;
-    int tokenCounter = 0;
-    while (!symbolStack.empty()) {
-        auto sp = symbolStack.top();
-        symbolStack.pop();
-        while (tokenIter->type == TokenType::NEWLINE) {
-            tokenIter++;
-            lineCounter++;
-            tokenCounter = 0;
-        }
+void SyntaxTreeBuilder::enter(Symbol symbol) {
+    if (path.empty()) {
+        root = std::make_shared<SyntaxTree>(symbol);
+        path.push_back(root.get());
+        return;
+    }
+    SyntaxTree* parent = path.back();
+    parent->addChild(SyntaxTree(symbol));
+    path.push_back(&parent->childAt(parent->childCount() - 1));
+}
 
-        if (!syntax.nonTerminatingSymbols().count(sp->symbol())) {
-            if (tokenIter == ts.end() || Symbol(tokenIter->type) != sp->symbol()) {
-                throw std::tuple<int, int, int>(tokenIter - ts.begin(), lineCounter, tokenCounter);
-            }
-            sp->setTokenData(*tokenIter++);
-            tokenCounter++;
-            continue;
-        }
+void SyntaxTreeBuilder::token(Token token, size_t) {
+    path.back()->addChild(SyntaxTree(token));
+}
 
-        Symbol tokenSymbol = Symbol(tokenIter->type);
-        if (tokenIter->type == TokenType::TOKEN_EOF) {
-            tokenSymbol = EPS;
-        }
-        if (!llMap[sp->symbol()].count(tokenSymbol)) {
-            throw std::tuple<int, int, int>(tokenIter - ts.begin(), lineCounter, tokenCounter);
-        }
-        auto sent = llMap[sp->symbol()].at(tokenSymbol);
-        sp->setChildSentence(sent);
-        for (size_t i = sp->childCount() - 1; i < sp->childCount(); i--) {
-            symbolStack.push(sp->shareChild(i));
-        }
-    }
+void SyntaxTreeBuilder::exit(Symbol) {
+    path.pop_back();
+}
+
+void SyntaxTreeBuilder::binary(Token op) {
+    SyntaxTree* parent = path.back();
+    auto rhs = parent->popChild();
+    auto lhs = parent->popChild();
+
+    auto expr = std::make_shared<SyntaxTree>(symbols::BI_EXPR);
+    expr->addChild(std::move(lhs));
+    expr->addChild(SyntaxTree(op));
+    expr->addChild(std::move(rhs));
+    parent->addChild(std::move(expr));
+}
 
-    return *stt;
-}
\ No newline at end of file
+SyntaxTree* SyntaxTreeBuilder::current() const {
+    return path.empty() ? nullptr : path.back();
+}
+
+SyntaxTree SyntaxTreeBuilder::result() {
+    return std::move(*root);
+}
+
+// If exception throws token count
+SyntaxTree pl0cc::llZeroParseSyntax(const Syntax &syntax, const TokenStorage &ts, const OperatorPrecedenceTable* exprTable) {
+    return llZeroParseSyntax(syntax, syntax.llMap(), ts, exprTable);
+}
+
+SyntaxTree pl0cc::llZeroParseSyntax(const Syntax &syntax, const LlMap &llMap, const TokenStorage &ts,
+                                    const OperatorPrecedenceTable* exprTable) {
+    SyntaxTreeBuilder builder;
+    llZeroParseSymbolEvents(syntax, llMap, syntax.start(), ts, 0, builder, exprTable);
+    return builder.result();
+}
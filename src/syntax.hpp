@@ -2,21 +2,25 @@
 #define PL0CC_SYNTAX_HPP
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <initializer_list>
 #include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <ostream>
 #include <set>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <utility>
 #include <vector>
 #include <unordered_set>
 
 #include "lexer.hpp"
+#include "trace.hpp"
 
 
 namespace pl0cc {
@@ -96,6 +100,9 @@ namespace pl0cc {
         Syntax(Symbol startSymbol) : emptySymbolSetValid(false), firstSetsValid(false), followSetsValid(false), startSymbol(startSymbol) {
             addSymbol(startSymbol);
         }
+        // Copies the grammar; the copy computes its own FIRST and FOLLOW sets
+        Syntax(const Syntax& other);
+        Syntax& operator=(const Syntax& other);
 
         void addConduct(Symbol leftPart, Sentence rightPart);
 
@@ -119,11 +126,16 @@ namespace pl0cc {
         std::map<Symbol, std::unordered_set<Sentence>> sentences;
         std::vector<std::pair<Symbol, Sentence>> conductVector;
 
-        mutable bool emptySymbolSetValid;
+        /*
+         * Filled on first use under cacheMutex, so that const methods of a finished Syntax can be
+         * called from several threads. A set flag means the cache is complete and read-only.
+         */
+        mutable std::mutex cacheMutex;
+        mutable std::atomic<bool> emptySymbolSetValid;
         mutable std::set<Symbol> emptySymbolSet;
-        mutable bool firstSetsValid;
+        mutable std::atomic<bool> firstSetsValid;
         mutable std::map<Symbol, std::set<Symbol>> firstSets;
-        mutable bool followSetsValid;
+        mutable std::atomic<bool> followSetsValid;
         mutable std::map<Symbol, std::set<Symbol>> followSets;
 
         Symbol addSymbol(Symbol sym);
@@ -140,16 +152,22 @@ namespace pl0cc {
         explicit SyntaxTree(Symbol symbol);
         
         Symbol symbol() const;
+        const std::optional<Token>& token() const;
         void addChild(SyntaxTree st);
+        void addChild(std::shared_ptr<SyntaxTree> st);
+        std::shared_ptr<SyntaxTree> popChild();
         size_t childCount() const;
         bool childExists(size_t index) const;
         const SyntaxTree& childAt(size_t index) const;
         SyntaxTree& childAt(size_t index);
         std::shared_ptr<SyntaxTree> shareChild(size_t index);
+        void replaceChild(size_t index, std::shared_ptr<SyntaxTree> st);
         void setChildSentence(const Sentence& sentence);
         void setTokenData(Token token);
+        size_t nodeCount() const;
 
-        void serializeTo(std::ostream& os, std::function<std::string(Symbol)> symbolName, int tabCount = 0);
+        void serializeTo(std::ostream& os, std::function<std::string(Symbol)> symbolName, int tabCount = 0) const;
+        void serializeTo(OutputBuffer& out, const std::function<std::string(Symbol)>& symbolName, int tabCount = 0) const;
     private:
         Symbol symbolData;
         std::optional<Token> tokenData;
@@ -197,6 +215,7 @@ namespace pl0cc {
         SYMDEF(BI_OP2,        294);
         SYMDEF(BI_OP1,        295);
         SYMDEF(TYPE,          296);
+        SYMDEF(BI_EXPR,       297);
 
 #undef SYMDEF
 
@@ -205,8 +224,237 @@ namespace pl0cc {
     }
 
     Syntax genSyntax();
+    // Same language as genSyntax(), but with left-recursive lists and operator levels for LR parsing
+    Syntax genLrSyntax();
+
+    /*
+     * Operator-precedence table for the binary operators of an expression symbol.
+     * Higher precedence binds tighter; operators of equal precedence associate to
+     * the left unless marked right associative.
+     */
+    class OperatorPrecedenceTable {
+    public:
+        struct Entry {
+            int precedence;
+            bool rightAssociative;
+        };
+
+        OperatorPrecedenceTable(Symbol expression, Symbol operand);
+
+        void addOperator(Symbol op, int precedence, bool rightAssociative = false);
+        [[nodiscard]] const Entry* find(Symbol op) const {
+            if (op >= entries.size() || entries[op].precedence == 0) return nullptr;
+            return &entries[op];
+        }
+
+        [[nodiscard]] Symbol expression() const { return exprSymbol; }
+        [[nodiscard]] Symbol operand() const { return operandSymbol; }
+    private:
+        Symbol exprSymbol, operandSymbol;
+        std::vector<Entry> entries;
+    };
+
+    // Builds the table from the BI_OP1 ... BI_OP6 conducts of genSyntax()
+    OperatorPrecedenceTable genOperatorTable(const Syntax& syntax);
+
+    /*
+     * Event-stream LL(1) driver. Instead of materializing a SyntaxTree, it reports
+     *   sink.enter(Symbol)  when a non-terminating symbol is expanded,
+     *   sink.token(Token, size_t index)  when the terminating symbol at index of the stream is matched,
+     *   sink.exit(Symbol)   when every symbol of the expansion has been consumed,
+     *   sink.binary(Token)  when both operands of a binary operator have been reported.
+     * The only storage is the symbol stack, so memory stays bounded by the parse depth.
+     *
+     * If exprTable is given, expressions are handed off to an operator-precedence parser:
+     * operands are parsed from the table's operand symbol and operators are reported
+     * in postfix order through sink.binary() instead of expanding the operator cascade.
+     *
+     * Throws std::tuple<int, int, int>(token index, line, token in line) like llZeroParseSyntax.
+     */
+    template <typename Sink>
+    void llZeroParseEvents(const Syntax& syntax, const TokenStorage& ts, Sink& sink,
+                           const OperatorPrecedenceTable* exprTable = nullptr);
+
+    using LlMap = std::map<Symbol, std::map<Symbol, Sentence>>;
+
+    // Token source of the LL(1) driver that walks a finished TokenStorage
+    class TokenStorageCursor {
+    public:
+        TokenStorageCursor(const TokenStorage& ts, size_t index) : pos(ts.begin() + long(index)), first(ts.begin()), last(ts.end()) {}
+
+        [[nodiscard]] const Token& peek() const { return *pos; }
+        Token next() { return *pos++; }
+        [[nodiscard]] bool atEnd() const { return pos == last; }
+        [[nodiscard]] size_t index() const { return size_t(pos - first); }
+    private:
+        std::vector<Token>::const_iterator pos, first, last;
+    };
+
+    /*
+     * Parses a single `start` symbol from a token cursor with a precomputed llMap, reporting
+     * events like llZeroParseEvents(). A cursor has peek(), next(), atEnd() and index(), the
+     * position in the whole token stream, like TokenStorageCursor; peek() at the end must
+     * return a TOKEN_EOF. Lines and tokens in the thrown tuple are counted from the first
+     * token read.
+     */
+    template <typename Cursor, typename Sink>
+    void llZeroParseTokens(const Syntax& syntax, const LlMap& llMap, Symbol start, Cursor& tokens, Sink& sink,
+                           const OperatorPrecedenceTable* exprTable = nullptr) {
+        PL0CC_TRACE_SCOPE("ll_parse");
+        enum class Action {
+            EXPAND, EXIT, OPERATOR
+        };
+        struct Frame {
+            Symbol symbol;
+            Action action;
+            size_t operatorBase;
+        };
+        struct PendingOperator {
+            Token token;
+            int precedence;
+        };
+
+        const auto& ntSymbols = syntax.nonTerminatingSymbols();
+
+        std::vector<Frame> symbolStack;
+        std::vector<PendingOperator> operators;
+        symbolStack.push_back({start, Action::EXPAND, 0});
+
+        int lineCounter = 0;
+        int tokenCounter = 0;
+        while (!symbolStack.empty()) {
+            Frame frame = symbolStack.back();
+            symbolStack.pop_back();
+
+            if (frame.action == Action::EXIT) {
+                sink.exit(frame.symbol);
+                continue;
+            }
+
+            while (tokens.peek().type == TokenType::NEWLINE) {
+                tokens.next();
+                lineCounter++;
+                tokenCounter = 0;
+            }
+
+            if (frame.action == Action::OPERATOR) {
+                const OperatorPrecedenceTable::Entry* op = exprTable->find(Symbol(tokens.peek().type));
+                while (
+                        operators.size() > frame.operatorBase && (
+                            op == nullptr ||
+                            operators.back().precedence > op->precedence ||
+                            (operators.back().precedence == op->precedence && !op->rightAssociative)
+                        )
+                ) {
+                    sink.binary(operators.back().token);
+                    operators.pop_back();
+                }
+                if (op != nullptr) {
+                    operators.push_back({tokens.next(), op->precedence});
+                    tokenCounter++;
+                    symbolStack.push_back(frame);
+                    symbolStack.push_back({exprTable->operand(), Action::EXPAND, 0});
+                }
+                continue;
+            }
+
+            if (!ntSymbols.count(frame.symbol)) {
+                if (tokens.atEnd() || Symbol(tokens.peek().type) != frame.symbol) {
+                    throw std::tuple<int, int, int>(int(tokens.index()), lineCounter, tokenCounter);
+                }
+                size_t index = tokens.index();
+                sink.token(tokens.next(), index);
+                tokenCounter++;
+                continue;
+            }
+
+            if (exprTable != nullptr && frame.symbol == exprTable->expression()) {
+                sink.enter(frame.symbol);
+                symbolStack.push_back({frame.symbol, Action::EXIT, 0});
+                symbolStack.push_back({frame.symbol, Action::OPERATOR, operators.size()});
+                symbolStack.push_back({exprTable->operand(), Action::EXPAND, 0});
+                continue;
+            }
+
+            Symbol tokenSymbol = Symbol(tokens.peek().type);
+            if (tokens.peek().type == TokenType::TOKEN_EOF) {
+                tokenSymbol = EPS;
+            }
+            auto row = llMap.find(frame.symbol);
+            if (row == llMap.end() || !row->second.count(tokenSymbol)) {
+                throw std::tuple<int, int, int>(int(tokens.index()), lineCounter, tokenCounter);
+            }
+            const Sentence& sent = row->second.at(tokenSymbol);
+
+            sink.enter(frame.symbol);
+            symbolStack.push_back({frame.symbol, Action::EXIT, 0});
+            for (size_t i = sent.size() - 1; i < sent.size(); i--) {
+                symbolStack.push_back({sent[i], Action::EXPAND, 0});
+            }
+        }
+    }
+
+    /*
+     * Parses a single `start` symbol from the token at tokenIndex on with a precomputed llMap,
+     * reporting events like llZeroParseEvents(). Returns the index after the last token consumed.
+     * Lines and tokens in the thrown tuple are counted from tokenIndex.
+     */
+    template <typename Sink>
+    size_t llZeroParseSymbolEvents(const Syntax& syntax, const LlMap& llMap, Symbol start,
+                                   const TokenStorage& ts, size_t tokenIndex, Sink& sink,
+                                   const OperatorPrecedenceTable* exprTable = nullptr) {
+        TokenStorageCursor tokens(ts, tokenIndex);
+        llZeroParseTokens(syntax, llMap, start, tokens, sink, exprTable);
+        return tokens.index();
+    }
+
+    template <typename Sink>
+    void llZeroParseEvents(const Syntax& syntax, const TokenStorage& ts, Sink& sink,
+                           const OperatorPrecedenceTable* exprTable) {
+        llZeroParseSymbolEvents(syntax, syntax.llMap(), syntax.start(), ts, 0, sink, exprTable);
+    }
+
+    // Sink that drops every event, for syntax validation only.
+    struct NullParseSink {
+        void enter(Symbol) {}
+        void token(Token, size_t) {}
+        void exit(Symbol) {}
+        void binary(Token) {}
+    };
+
+    // Forwards to another sink and counts the events, one per step of the LL(1) driver.
+    template <typename Sink>
+    struct CountingParseSink {
+        Sink& sink;
+        size_t steps = 0;
+
+        void enter(Symbol symbol) { steps++; sink.enter(symbol); }
+        void token(Token token, size_t index) { steps++; sink.token(token, index); }
+        void exit(Symbol symbol) { steps++; sink.exit(symbol); }
+        void binary(Token op) { steps++; sink.binary(op); }
+    };
+
+    // Sink that rebuilds the concrete SyntaxTree from the event stream.
+    class SyntaxTreeBuilder {
+    public:
+        void enter(Symbol symbol);
+        void token(Token token, size_t index);
+        void exit(Symbol symbol);
+        void binary(Token op);
+
+        // Node the next event attaches to, nullptr before the first enter()
+        [[nodiscard]] SyntaxTree* current() const;
+        SyntaxTree result();
+    private:
+        std::shared_ptr<SyntaxTree> root;
+        std::vector<SyntaxTree*> path;
+    };
 
-    SyntaxTree llZeroParseSyntax(const Syntax& syntax, const TokenStorage& ts);
+    SyntaxTree llZeroParseSyntax(const Syntax& syntax, const TokenStorage& ts,
+                                 const OperatorPrecedenceTable* exprTable = nullptr);
+    // Same with a prebuilt syntax.llMap(), which can be shared between threads
+    SyntaxTree llZeroParseSyntax(const Syntax& syntax, const LlMap& llMap, const TokenStorage& ts,
+                                 const OperatorPrecedenceTable* exprTable = nullptr);
 }
 
 #endif
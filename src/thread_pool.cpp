@@ -0,0 +1,96 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+using namespace pl0cc;
+
+namespace {
+    // Index of the pool worker running on this thread, for submissions from inside tasks
+    thread_local const WorkStealingPool* currentPool = nullptr;
+    thread_local size_t currentWorker = 0;
+}
+
+WorkStealingPool::WorkStealingPool(size_t threadCount) :
+    workers(), threads(), queued(0), unfinished(0), nextWorker(0), stopping(false), firstError() {
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < threadCount; i++) workers.push_back(std::make_unique<Worker>());
+    for (size_t i = 0; i < threadCount; i++) threads.emplace_back(&WorkStealingPool::run, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (std::thread& thread : threads) thread.join();
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+    size_t index = currentPool == this ? currentWorker : nextWorker++ % workers.size();
+    unfinished++;
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+        queued++;
+    }
+    // Sleeping workers check queued under sleepMutex, so taking it here orders the wake-up after their check
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    taskAvailable.notify_one();
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    allFinished.wait(lock, [this] { return unfinished == 0; });
+    if (firstError) std::rethrow_exception(std::exchange(firstError, nullptr));
+}
+
+bool WorkStealingPool::takeTask(size_t index, std::function<void()>& task) {
+    {
+        Worker& own = *workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+    for (size_t k = 1; k < workers.size(); k++) {
+        Worker& victim = *workers[(index + k) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(size_t index) {
+    currentPool = this;
+    currentWorker = index;
+    std::function<void()> task;
+    while (true) {
+        if (takeTask(index, task)) {
+            try {
+                task();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                if (!firstError) firstError = std::current_exception();
+            }
+            task = nullptr;
+            if (--unfinished == 0) {
+                { std::lock_guard<std::mutex> lock(sleepMutex); }
+                allFinished.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        taskAvailable.wait(lock, [this] { return queued > 0 || stopping; });
+        if (stopping && queued == 0) return;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef PL0CC_THREAD_POOL_HPP
+#define PL0CC_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pl0cc {
+    /*
+     * Fixed-size thread pool where every worker owns a task deque. A worker takes its newest
+     * task first and, once its deque is empty, steals the oldest task of another worker, so
+     * long and short tasks even out without a shared queue.
+     */
+    class WorkStealingPool {
+    public:
+        // 0 picks std::thread::hardware_concurrency()
+        explicit WorkStealingPool(size_t threadCount = 0);
+        // Finishes the queued tasks, then joins the workers
+        ~WorkStealingPool();
+
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+        // From a worker the task goes to its own deque, otherwise the deques take turns
+        void submit(std::function<void()> task);
+        // Blocks until every submitted task has finished; rethrows the first exception a task threw
+        void wait();
+
+        [[nodiscard]] size_t threadCount() const { return threads.size(); }
+    private:
+        struct Worker {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+        std::atomic<size_t> queued, unfinished, nextWorker;
+        std::mutex sleepMutex;
+        std::condition_variable taskAvailable, allFinished;
+        bool stopping;
+        std::exception_ptr firstError;
+
+        void run(size_t index);
+        bool takeTask(size_t index, std::function<void()>& task);
+    };
+}
+
+#endif // PL0CC_THREAD_POOL_HPP
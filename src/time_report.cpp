@@ -0,0 +1,93 @@
+#include "time_report.hpp"
+
+#include <iomanip>
+
+using namespace pl0cc;
+
+namespace {
+    constexpr const char* phaseNames[] {
+        "automaton", "grammar", "parse_tables", "read", "lex", "parse", "output"
+    };
+    constexpr const char* counterNames[] {
+        "files", "input_bytes", "tokens", "dfa_states", "parse_steps", "tree_nodes"
+    };
+
+    double perSecond(std::uint64_t amount, double seconds) {
+        return seconds > 0 ? double(amount) / seconds : 0;
+    }
+}
+
+TimeReport::TimeReport() : start(Clock::now()), totalNanoseconds(0), phaseNanoseconds(), counters() {
+    for (auto& phase : phaseNanoseconds) phase = 0;
+    for (auto& counter : counters) counter = 0;
+}
+
+void TimeReport::add(Phase phase, Clock::duration elapsed) {
+    phaseNanoseconds[size_t(phase)] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+void TimeReport::count(Counter counter, std::uint64_t amount) {
+    counters[size_t(counter)] += amount;
+}
+
+void TimeReport::finish() {
+    totalNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+void TimeReport::printTo(std::ostream& os) const {
+    std::int64_t phaseTotal = 0;
+    for (const auto& phase : phaseNanoseconds) phaseTotal += phase;
+
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed;
+    os << "Time report >---------------\n";
+    os << "Phase           Time (ms)       %\n";
+    for (size_t i = 0; i < size_t(Phase::COUNT); i++) {
+        double share = phaseTotal > 0 ? 100.0 * double(phaseNanoseconds[i]) / double(phaseTotal) : 0;
+        os << std::left << std::setw(14) << phaseNames[i] << std::right
+           << std::setw(11) << std::setprecision(3) << seconds(phaseNanoseconds[i]) * 1e3
+           << std::setw(8) << std::setprecision(1) << share << '\n';
+    }
+    os << std::left << std::setw(14) << "wall" << std::right
+       << std::setw(11) << std::setprecision(3) << wallSeconds() * 1e3 << '\n';
+
+    auto counter = [this](Counter c) { return counters[size_t(c)].load(); };
+    const std::uint64_t bytes = counter(Counter::INPUT_BYTES), tokens = counter(Counter::TOKENS);
+    const double lexSeconds = seconds(phaseNanoseconds[size_t(Phase::LEX)]);
+    const double parseSeconds = seconds(phaseNanoseconds[size_t(Phase::PARSE)]);
+    // Bytes go through the lexer and tokens through both; wall time also covers tables and output
+    os << "Throughput against  bytes/s    tokens/s\n" << std::setprecision(0)
+       << std::left << std::setw(14) << "lex time" << std::right
+       << std::setw(13) << perSecond(bytes, lexSeconds) << std::setw(12) << perSecond(tokens, lexSeconds) << '\n'
+       << std::left << std::setw(14) << "parse time" << std::right
+       << std::setw(13) << "-" << std::setw(12) << perSecond(tokens, parseSeconds) << '\n'
+       << std::left << std::setw(14) << "wall time" << std::right
+       << std::setw(13) << perSecond(bytes, wallSeconds()) << std::setw(12) << perSecond(tokens, wallSeconds()) << '\n';
+    os << counter(Counter::FILES) << " files, "
+       << bytes << " bytes, "
+       << tokens << " tokens\n"
+       << counter(Counter::DFA_STATES) << " DFA states, "
+       << counter(Counter::PARSE_STEPS) << " parse steps, "
+       << counter(Counter::TREE_NODES) << " tree nodes\n";
+    os.flags(flags);
+}
+
+JsonValue TimeReport::toJson() const {
+    JsonValue report;
+    report["wall_seconds"] = wallSeconds();
+    for (size_t i = 0; i < size_t(Phase::COUNT); i++) {
+        report["phase_seconds"][phaseNames[i]] = seconds(phaseNanoseconds[i]);
+    }
+    for (size_t i = 0; i < size_t(Counter::COUNT); i++) {
+        report["counters"][counterNames[i]] = counters[i].load();
+    }
+    // Each rate is keyed by the time it is measured against
+    const std::uint64_t bytes = counters[size_t(Counter::INPUT_BYTES)], tokens = counters[size_t(Counter::TOKENS)];
+    const double lexSeconds = seconds(phaseNanoseconds[size_t(Phase::LEX)]);
+    report["throughput"]["lex"]["bytes_per_second"] = perSecond(bytes, lexSeconds);
+    report["throughput"]["lex"]["tokens_per_second"] = perSecond(tokens, lexSeconds);
+    report["throughput"]["parse"]["tokens_per_second"] = perSecond(tokens, seconds(phaseNanoseconds[size_t(Phase::PARSE)]));
+    report["throughput"]["wall"]["bytes_per_second"] = perSecond(bytes, wallSeconds());
+    report["throughput"]["wall"]["tokens_per_second"] = perSecond(tokens, wallSeconds());
+    return report;
+}
@@ -0,0 +1,68 @@
+#ifndef PL0CC_TIME_REPORT_HPP
+#define PL0CC_TIME_REPORT_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#include "json.hpp"
+
+namespace pl0cc {
+    /*
+     * Wall time and counters of the compiler phases for --time-report. Any thread may add to a
+     * report; with -j the phase times of all files add up and can exceed the total wall time.
+     * Throughput is reported against the lex and parse phase times as well as the wall time.
+     */
+    class TimeReport {
+    public:
+        enum class Phase {
+            AUTOMATON, GRAMMAR, PARSE_TABLES, READ, LEX, PARSE, OUTPUT, COUNT
+        };
+        enum class Counter {
+            FILES, INPUT_BYTES, TOKENS, DFA_STATES, PARSE_STEPS, TREE_NODES, COUNT
+        };
+
+        using Clock = std::chrono::steady_clock;
+
+        // Adds the time until stop() or destruction to a phase; does nothing for a null report
+        class Timer {
+        public:
+            Timer(TimeReport* report, Phase phase) : report(report), phase(phase), start(Clock::now()) {}
+            ~Timer() { stop(); }
+
+            Timer(const Timer&) = delete;
+            Timer& operator=(const Timer&) = delete;
+
+            void stop() {
+                if (report != nullptr) report->add(phase, Clock::now() - start);
+                report = nullptr;
+            }
+        private:
+            TimeReport* report;
+            Phase phase;
+            Clock::time_point start;
+        };
+
+        // The total wall time runs from construction to finish()
+        TimeReport();
+
+        void add(Phase phase, Clock::duration elapsed);
+        void count(Counter counter, std::uint64_t amount);
+        void finish();
+
+        void printTo(std::ostream& os) const;
+        [[nodiscard]] JsonValue toJson() const;
+    private:
+        Clock::time_point start;
+        std::atomic<std::int64_t> totalNanoseconds;
+        std::array<std::atomic<std::int64_t>, size_t(Phase::COUNT)> phaseNanoseconds;
+        std::array<std::atomic<std::uint64_t>, size_t(Counter::COUNT)> counters;
+
+        [[nodiscard]] double seconds(std::int64_t nanoseconds) const { return double(nanoseconds) / 1e9; }
+        [[nodiscard]] double wallSeconds() const { return seconds(totalNanoseconds); }
+    };
+}
+
+#endif // PL0CC_TIME_REPORT_HPP
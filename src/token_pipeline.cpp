@@ -0,0 +1,98 @@
+#include "token_pipeline.hpp"
+
+#include <algorithm>
+
+#include "memory_report.hpp"
+#include "trace.hpp"
+
+using namespace pl0cc;
+
+namespace {
+    // Source bytes lexed between two pushes; a few thousand tokens
+    constexpr size_t LEX_CHUNK = 16 << 10;
+    constexpr int SPINS_BEFORE_YIELD = 64;
+
+    size_t roundUpToPowerOfTwo(size_t n) {
+        size_t power = 1;
+        while (power < n) power <<= 1;
+        return power;
+    }
+
+    void backOff(int& spins) {
+        if (++spins > SPINS_BEFORE_YIELD) std::this_thread::yield();
+    }
+}
+
+const Token TokenRingCursor::endToken {TokenType::TOKEN_EOF, -1};
+
+TokenRing::TokenRing(size_t capacity) :
+    slots(roundUpToPowerOfTwo(std::max<size_t>(capacity, 2)), Token(TokenType::TOKEN_EOF, -1)),
+    mask(slots.size() - 1), head(0), tail(0), finished(false), closed(false), producerError() {}
+
+void TokenRing::push(const Token* tokens, size_t count) {
+    size_t pushed = head.load(std::memory_order_relaxed);
+    while (count > 0) {
+        int spins = 0;
+        size_t room;
+        while ((room = slots.size() - (pushed - tail.load(std::memory_order_acquire))) == 0) {
+            if (closed.load(std::memory_order_acquire)) return;
+            backOff(spins);
+        }
+        size_t batch = std::min(room, count);
+        for (size_t i = 0; i < batch; i++) slots[(pushed + i) & mask] = tokens[i];
+        pushed += batch;
+        head.store(pushed, std::memory_order_release);
+        tokens += batch;
+        count -= batch;
+    }
+}
+
+void TokenRing::finish(std::exception_ptr error) {
+    producerError = std::move(error);
+    finished.store(true, std::memory_order_release);
+}
+
+void TokenRing::close() {
+    closed.store(true, std::memory_order_release);
+}
+
+bool TokenRingCursor::refill() {
+    // Hands the consumed slots back before waiting for new ones
+    ring.tail.store(pos, std::memory_order_release);
+    int spins = 0;
+    while (true) {
+        available = ring.head.load(std::memory_order_acquire);
+        if (available != pos) return true;
+        if (ring.finished.load(std::memory_order_acquire)) {
+            available = ring.head.load(std::memory_order_acquire);
+            return available != pos;
+        }
+        backOff(spins);
+    }
+}
+
+void pl0cc::lexIntoRing(Lexer& lexer, std::string_view source, TokenRing& ring, TimeReport* report) {
+    PL0CC_TRACE_SCOPE("lex");
+    TimeReport::Timer lexTimer(report, TimeReport::Phase::LEX);
+    memory::PhaseScope lexPhase(memory::Phase::LEX);
+    const TokenStorage& ts = lexer.tokenStorage();
+    size_t pushed = 0;
+    // Tokens the lexer may still take back by backing up stay out of the ring
+    auto pushNewTokens = [&] {
+        size_t settled = lexer.settledTokenCount();
+        if (settled == pushed) return;
+        ring.push(&*(ts.begin() + long(pushed)), settled - pushed);
+        pushed = settled;
+    };
+    try {
+        for (size_t offset = 0; offset < source.size(); offset += LEX_CHUNK) {
+            for (char c : source.substr(offset, LEX_CHUNK)) lexer.feedChar(c);
+            pushNewTokens();
+        }
+        lexer.eof();
+        pushNewTokens();
+        ring.finish();
+    } catch (...) {
+        ring.finish(std::current_exception());
+    }
+}
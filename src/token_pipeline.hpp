@@ -0,0 +1,103 @@
+#ifndef PL0CC_TOKEN_PIPELINE_HPP
+#define PL0CC_TOKEN_PIPELINE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "lexer.hpp"
+#include "time_report.hpp"
+
+namespace pl0cc {
+    /*
+     * Bounded single-producer, single-consumer token queue between a lexing and a parsing
+     * thread. Both sides only touch their own index and publish it with release stores, the
+     * producer per batch and the consumer each time it runs dry; whoever finds the ring full
+     * or empty spins briefly, then yields.
+     */
+    class TokenRing {
+    public:
+        static constexpr size_t DEFAULT_CAPACITY = size_t(1) << 16;
+
+        // capacity is rounded up to a power of two
+        explicit TokenRing(size_t capacity = DEFAULT_CAPACITY);
+
+        TokenRing(const TokenRing&) = delete;
+        TokenRing& operator=(const TokenRing&) = delete;
+
+        // Producer: waits for room; dropped once the consumer has closed the ring
+        void push(const Token* tokens, size_t count);
+        // Producer: no tokens follow; error, if any, is rethrown by the consumer
+        void finish(std::exception_ptr error = nullptr);
+
+        // Consumer: stops reading early, so that push() no longer waits
+        void close();
+        [[nodiscard]] std::exception_ptr error() const { return producerError; }
+    private:
+        friend class TokenRingCursor;
+
+        std::vector<Token> slots;
+        size_t mask;
+        alignas(64) std::atomic<size_t> head;   // Tokens pushed
+        alignas(64) std::atomic<size_t> tail;   // Tokens consumed
+        alignas(64) std::atomic<bool> finished;
+        std::atomic<bool> closed;
+        std::exception_ptr producerError;
+    };
+
+    // Consumer side of a TokenRing, usable as an llZeroParseTokens() cursor
+    class TokenRingCursor {
+    public:
+        explicit TokenRingCursor(TokenRing& ring) : ring(ring), pos(0), available(0) {}
+
+        [[nodiscard]] const Token& peek() {
+            if (pos == available && !refill()) return endToken;
+            return ring.slots[pos & ring.mask];
+        }
+        Token next() {
+            Token token = peek();
+            if (pos != available) pos++;
+            return token;
+        }
+        [[nodiscard]] bool atEnd() { return pos == available && !refill(); }
+        [[nodiscard]] size_t index() const { return pos; }
+    private:
+        static const Token endToken;
+
+        TokenRing& ring;
+        size_t pos;
+        size_t available;   // Pushed tokens seen at the last refill
+
+        bool refill();
+    };
+
+    // Lexes source into lexer and pushes the tokens to ring in batches, then finishes the ring
+    void lexIntoRing(Lexer& lexer, std::string_view source, TokenRing& ring, TimeReport* report = nullptr);
+
+    /*
+     * Lexes source on a second thread while parse(cursor) reads the tokens on this one, so a
+     * file takes about as long as the slower of the two. The lexer always runs to the end,
+     * and its errors take the place of any exception from parse, which is rethrown otherwise.
+     */
+    template <typename Parse>
+    void lexAndParse(Lexer& lexer, std::string_view source, TimeReport* report, Parse&& parse) {
+        TokenRing ring;
+        std::thread lexing([&] { lexIntoRing(lexer, source, ring, report); });
+        TokenRingCursor cursor(ring);
+        std::exception_ptr parseError;
+        try {
+            parse(cursor);
+        } catch (...) {
+            parseError = std::current_exception();
+        }
+        ring.close();
+        lexing.join();
+        if (ring.error()) std::rethrow_exception(ring.error());
+        if (parseError && lexer.errorCount() == 0) std::rethrow_exception(parseError);
+    }
+}
+
+#endif // PL0CC_TOKEN_PIPELINE_HPP
@@ -1,12 +1,30 @@
-#include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
 #include "lexer.hpp"
+#include "memory_report.hpp"
+#include "output_buffer.hpp"
+#include "trace.hpp"
 
 namespace pl0cc {
     TokenStorage::TokenStorage() = default;
 
-    void TokenStorage::pushToken(RawToken token) {
+    TokenStorage::TokenStorage(std::vector<Token> tokens, std::vector<std::string> symbols,
+                               std::vector<std::string> numberConstants, std::vector<std::string> stringConstants) :
+        tokens(std::move(tokens)), symbols(std::move(symbols)),
+        numberConstants(std::move(numberConstants)) {
+        for (size_t i = 0; i < this->symbols.size(); i++) symbolMap.emplace(this->symbols[i], int(i));
+        std::vector<std::string> spellings;
+        spellings.swap(this->numberConstants);
+        for (std::string& spelling : spellings) internNumber(std::move(spelling));
+        for (const std::string& spelling : stringConstants) strings.intern(spelling);
+    }
+
+    void TokenStorage::pushToken(RawToken token, size_t sourceOffset) {
         int seman;
         TokenType type = token.type();
+        memory::PhaseScope internPhase(memory::Phase::INTERN);
 
         switch (type) {
             case TokenType::SYMBOL:
@@ -18,90 +36,110 @@ namespace pl0cc {
                 }
                 break;
             case TokenType::NUMBER:
-                if (!numberConstantMap.count(token.content())) {
-                    seman = numberConstantMap[token.content()] = static_cast<int>(numberConstants.size());
-                    numberConstants.push_back(std::move(token.content()));
-                } else {
-                    seman = numberConstantMap[token.content()];
-                }
+                seman = internNumber(std::move(token.content()));
                 break;
             case TokenType::STRING:
-                if (!stringConstantMap.count(token.content())) {
-                    seman = stringConstantMap[token.content()] = static_cast<int>(stringConstants.size());
-                    stringConstants.push_back(std::move(token.content()));
-                } else {
-                    seman = stringConstantMap[token.content()];
-                }
+                seman = strings.intern(token.content(), sourceOffset);
                 break;
             default:
                 seman = -1;
                 break;
         }
+        internPhase.leave();
 
         tokens.emplace_back(type, seman);
     }
 
-    void TokenStorage::serializeTo(std::ostream& ss) const {
-        ss << "Tokens >--------------------\n";
-        ss << "Type            Seman\n";
-        for (auto token : tokens) {
-            std::stringstream ssLine;
+    NumberValue NumberValue::parse(std::string_view spelling) {
+        NumberValue value;
+        const char* first = spelling.data();
+        const char* last = first + spelling.size();
+        if (spelling.find_first_of(".eE") == std::string_view::npos) {
+            auto [end, error] = std::from_chars(first, last, value.integer);
+            if (error == std::errc() && end == last) return value;
+        }
+        // libstdc++ parses doubles with the Eisel-Lemire fast path
+        value.kind = Kind::REAL;
+        auto [end, error] = std::from_chars(first, last, value.real);
+        if (error != std::errc()) {
+            // Out of range: strtod gives the infinity or zero that the literal rounds to
+            value.real = std::strtod(std::string(spelling).c_str(), nullptr);
+        }
+        return value;
+    }
 
-            ssLine << int(token.type);
-            while (ssLine.tellp() < 2) ssLine << ' ';
+    int TokenStorage::internNumber(std::string spelling) {
+        NumberValue value = NumberValue::parse(spelling);
+        std::uint64_t bits = value.integer;
+        if (value.kind == NumberValue::Kind::REAL) std::memcpy(&bits, &value.real, sizeof bits);
+        auto [entry, added] = numberConstantMap.emplace(std::pair {value.kind, bits}, int(numberConstants.size()));
+        if (added) {
+            numberConstants.push_back(std::move(spelling));
+            numberValues.push_back(value);
+        }
+        return entry->second;
+    }
 
-            ssLine << "(" << tokenTypeName(token.type) << ")";
-            while (ssLine.tellp() < 16) ssLine << ' ';
+    namespace {
+        constexpr size_t TOKEN_TYPE_COUNT = size_t(TokenType::ARROW) + 1;
+
+        // "<type>(<name>)" padded to the seman column, for each token type
+        const std::vector<std::string>& tokenLinePrefixes() {
+            static const std::vector<std::string> prefixes = [] {
+                std::vector<std::string> lines;
+                for (size_t type = 0; type < TOKEN_TYPE_COUNT; type++) {
+                    std::string line = std::to_string(type);
+                    line.resize(std::max<size_t>(line.size(), 2), ' ');
+                    line += "(" + tokenTypeName(TokenType(type)) + ")";
+                    line.resize(std::max<size_t>(line.size(), 16), ' ');
+                    lines.push_back(std::move(line));
+                }
+                return lines;
+            }();
+            return prefixes;
+        }
 
-            if (token.seman == -1) {
-                ssLine << '^';
-            } else {
-                ssLine << token.seman;
+        template <typename Entry>
+        void serializeTable(OutputBuffer& out, std::string_view title, size_t size, Entry entry) {
+            out.put(title);
+            out.put("Index  Value\n");
+            for (size_t i=0; i<size; i++) {
+                out.putUnsignedPadded(i, 7);
+                out.put(entry(i));
+                out.put('\n');
             }
-            ss << ssLine.str() << '\n';
+            out.put('\n');
         }
-        ss << '\n';
 
-        ss << "Symbols >-------------------\n";
-        ss << "Index  Value\n";
-        for (size_t i=0; i<symbols.size(); i++) {
-            std::stringstream ssLine;
-
-            ssLine << i;
-            while (ssLine.tellp() < 7) ssLine << ' ';
-
-            ssLine << symbols[i];
-
-            ss << ssLine.str()<< '\n';
+        void serializeTable(OutputBuffer& out, std::string_view title, const std::vector<std::string>& table) {
+            serializeTable(out, title, table.size(), [&table](size_t i) -> std::string_view { return table[i]; });
         }
-        ss << '\n';
-
-        ss << "Numbers >-------------------\n";
-        ss << "Index  Value\n";
-        for (size_t i=0; i<numberConstants.size(); i++) {
-            std::stringstream ssLine;
-
-            ssLine << i;
-            while (ssLine.tellp() < 7) ssLine << ' ';
+    }
 
-            ssLine << numberConstants[i];
+    void TokenStorage::serializeTo(std::ostream& ss) const {
+        OutputBuffer out(ss);
+        serializeTo(out);
+    }
 
-            ss << ssLine.str()<< '\n';
+    void TokenStorage::serializeTo(OutputBuffer& out) const {
+        PL0CC_TRACE_SCOPE("serialize_tokens");
+        const std::vector<std::string>& prefixes = tokenLinePrefixes();
+        out.put("Tokens >--------------------\n");
+        out.put("Type            Seman\n");
+        for (auto token : tokens) {
+            out.put(prefixes[size_t(token.type)]);
+            if (token.seman == -1) {
+                out.put('^');
+            } else {
+                out.putInt(token.seman);
+            }
+            out.put('\n');
         }
-        ss << '\n';
+        out.put('\n');
 
-        ss << "Strings >-------------------\n";
-        ss << "Index  Value\n";
-        for (size_t i=0; i<stringConstants.size(); i++) {
-            std::stringstream ssLine;
-
-            ssLine << i;
-            while (ssLine.tellp() < 7) ssLine << ' ';
-
-            ssLine << stringConstants[i];
-
-            ss << ssLine.str()<< '\n';
-        }
-        ss << '\n';
+        serializeTable(out, "Symbols >-------------------\n", symbols);
+        serializeTable(out, "Numbers >-------------------\n", numberConstants);
+        serializeTable(out, "Strings >-------------------\n", strings.size(),
+                       [this](size_t i) { return strings.spelling(i); });
     }
 } // pl0cc
\ No newline at end of file
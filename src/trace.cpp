@@ -0,0 +1,131 @@
+#include "trace.hpp"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "output_buffer.hpp"
+
+using namespace pl0cc;
+
+namespace {
+    struct Event {
+        const char* name;
+        std::string detail;
+        std::int64_t start;
+        std::int64_t duration;
+    };
+
+    // Only the owning thread appends; writeTo() reads after all recording threads are done
+    struct ThreadBuffer {
+        size_t id;
+        std::vector<Event> events;
+    };
+
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> registry;
+    thread_local ThreadBuffer* threadBuffer = nullptr;
+    std::atomic<std::int64_t> epoch {0};
+
+    ThreadBuffer& currentBuffer() {
+        if (threadBuffer == nullptr) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            registry.push_back(std::make_unique<ThreadBuffer>(ThreadBuffer {registry.size(), {}}));
+            registry.back()->events.reserve(1024);
+            threadBuffer = registry.back().get();
+        }
+        return *threadBuffer;
+    }
+
+    void putEscaped(OutputBuffer& out, std::string_view s) {
+        constexpr char hex[] = "0123456789abcdef";
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                out.put('\\');
+                out.put(c);
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                out.put("\\u00");
+                out.put(hex[(c >> 4) & 0xf]);
+                out.put(hex[c & 0xf]);
+            } else {
+                out.put(c);
+            }
+        }
+    }
+
+    // Trace timestamps are microseconds; keep the nanoseconds as three decimals
+    void putMicroseconds(OutputBuffer& out, std::int64_t nanoseconds) {
+        out.putInt(nanoseconds / 1000);
+        out.put('.');
+        std::int64_t fraction = nanoseconds % 1000;
+        if (fraction < 100) out.put('0');
+        if (fraction < 10) out.put('0');
+        out.putInt(fraction);
+    }
+}
+
+bool trace::compiledIn() {
+#if PL0CC_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::int64_t trace::now() {
+    auto sinceClockEpoch = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(sinceClockEpoch).count() - epoch.load(std::memory_order_relaxed);
+}
+
+void trace::enable() {
+    epoch = 0;
+    epoch = now();
+    active = true;
+}
+
+void trace::record(const char* name, std::string detail, std::int64_t start, std::int64_t duration) {
+    currentBuffer().events.push_back(Event {name, std::move(detail), start, duration});
+}
+
+bool trace::writeTo(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) return false;
+
+    bool written;
+    {
+        OutputBuffer out(fd);
+        std::lock_guard<std::mutex> lock(registryMutex);
+        out.put("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        out.put("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"pl0cc\"}}");
+        for (const auto& buffer : registry) {
+            out.put(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":");
+            out.putUnsigned(buffer->id);
+            out.put(",\"args\":{\"name\":\"thread ");
+            out.putUnsigned(buffer->id);
+            out.put("\"}}");
+            for (const Event& event : buffer->events) {
+                out.put(",\n{\"name\":\"");
+                putEscaped(out, event.name);
+                out.put("\",\"ph\":\"X\",\"pid\":1,\"tid\":");
+                out.putUnsigned(buffer->id);
+                out.put(",\"ts\":");
+                putMicroseconds(out, event.start);
+                out.put(",\"dur\":");
+                putMicroseconds(out, event.duration);
+                if (!event.detail.empty()) {
+                    out.put(",\"args\":{\"detail\":\"");
+                    putEscaped(out, event.detail);
+                    out.put("\"}");
+                }
+                out.put('}');
+            }
+        }
+        out.put("\n]}\n");
+        written = out.flush();
+    }
+    return ::close(fd) == 0 && written;
+}
@@ -0,0 +1,60 @@
+#ifndef PL0CC_TRACE_HPP
+#define PL0CC_TRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+ * Chrome trace-event recording for --trace, opened by chrome://tracing and Perfetto.
+ * Configure with -DPL0CC_TRACING=ON to compile it in; otherwise the PL0CC_TRACE_* macros expand
+ * to nothing and their arguments are not evaluated.
+ *
+ * Every thread appends to its own event buffer without locking; only the first event of a
+ * thread takes a lock to register the buffer. writeTo() must run once no thread records.
+ */
+namespace pl0cc::trace {
+    inline std::atomic<bool> active {false};
+
+    // false unless built with PL0CC_TRACING
+    bool compiledIn();
+    // Starts recording; the trace's time zero is now
+    void enable();
+    // Returns false if the file cannot be written
+    bool writeTo(const std::string& filename);
+
+    std::int64_t now();
+    void record(const char* name, std::string detail, std::int64_t start, std::int64_t duration);
+
+    // Records the time from construction to destruction as one complete event
+    class Scope {
+    public:
+        explicit Scope(const char* name, std::string detail = std::string()) :
+            name(name), detail(), start(active.load(std::memory_order_relaxed) ? now() : -1) {
+            if (start >= 0) this->detail = std::move(detail);
+        }
+        ~Scope() {
+            if (start >= 0) record(name, std::move(detail), start, now() - start);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        const char* name;
+        std::string detail;
+        std::int64_t start;
+    };
+}
+
+#define PL0CC_TRACE_CONCAT_(a, b) a##b
+#define PL0CC_TRACE_CONCAT(a, b) PL0CC_TRACE_CONCAT_(a, b)
+
+#if PL0CC_TRACING
+#define PL0CC_TRACE_SCOPE(name) ::pl0cc::trace::Scope PL0CC_TRACE_CONCAT(traceScope, __LINE__)(name)
+#define PL0CC_TRACE_SCOPE_DETAIL(name, detail) ::pl0cc::trace::Scope PL0CC_TRACE_CONCAT(traceScope, __LINE__)(name, detail)
+#else
+#define PL0CC_TRACE_SCOPE(name) ((void)0)
+#define PL0CC_TRACE_SCOPE_DETAIL(name, detail) ((void)0)
+#endif
+
+#endif // PL0CC_TRACE_HPP
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <malloc.h>
+
+#include "deterministic_automaton.hpp"
+#include "nondeterministic_automaton.hpp"
+#include "regex_parse.hpp"
+
+/*
+ * Times the stages of automaton construction on parameterized pattern families and reports
+ * the median time, the peak heap growth and the state counts of every stage:
+ *   tokenize  regexTokenize()
+ *   nfa       buildNfa(), joining several patterns with a markup each as Lexer::buildAutomaton does
+ *   subset    toDeterministic(false), the subset construction alone
+ *   simplify  DeterministicAutomaton::simplify() on that result
+ * Heap use is counted by replacing the global operator new of this program.
+ *   pl0cc_automaton_bench [--family keywords|alternation|class|blowup] [--sizes 8,32] [--repeat 5]
+ */
+namespace {
+    size_t liveBytes = 0;
+    size_t peakBytes = 0;
+
+    void* allocate(size_t size) {
+        void* p = std::malloc(size == 0 ? 1 : size);
+        if (p == nullptr) throw std::bad_alloc();
+        liveBytes += malloc_usable_size(p);
+        peakBytes = std::max(peakBytes, liveBytes);
+        return p;
+    }
+
+    void release(void* p) noexcept {
+        if (p == nullptr) return;
+        liveBytes -= malloc_usable_size(p);
+        std::free(p);
+    }
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    enum Stage { TOKENIZE, NFA, SUBSET, SIMPLIFY, STAGE_COUNT };
+    constexpr const char* stageNames[] {"tokenize", "nfa", "subset", "simplify"};
+
+    // Letters only, so no word contains a regex operator
+    std::string word(size_t index) {
+        std::string w = "k";
+        do {
+            w += char('a' + index % 26);
+            index /= 26;
+        } while (index > 0);
+        return w;
+    }
+
+    // n keywords next to an identifier class, like the lexer's token table; each is its own pattern
+    std::vector<std::string> keywords(size_t n) {
+        std::vector<std::string> patterns;
+        for (size_t i = 0; i < n; i++) patterns.push_back(word(i));
+        patterns.emplace_back("[_a-zA-Z][_a-zA-Z0-9]*");
+        return patterns;
+    }
+
+    // Alternations nested n deep; the pattern doubles with every level
+    std::string alternation(size_t n) {
+        std::string pattern = "a";
+        for (size_t level = 1; level <= n; level++) {
+            pattern = "(" + pattern + "|" + char('a' + level % 26) + pattern + ")";
+        }
+        return pattern;
+    }
+
+    // Dash-separated runs from a class of n printable characters
+    std::string characterClass(size_t n) {
+        std::string members;
+        for (char c = '!'; c <= '~' && members.size() < n; c++) {
+            if (c == ']' || c == '\\' || c == '^' || c == '-') continue;
+            members += c;
+        }
+        return "[" + members + "]+(-[" + members + "]+)*";
+    }
+
+    // (a|b)*a(a|b)^n: the DFA has to remember the last n+1 characters, 2^(n+1) states
+    std::string blowup(size_t n) {
+        std::string pattern = "(a|b)*a";
+        for (size_t i = 0; i < n; i++) pattern += "(a|b)";
+        return pattern;
+    }
+
+    struct Family {
+        const char* name;
+        std::function<std::vector<std::string>(size_t)> patterns;
+        std::vector<size_t> sizes;
+    };
+
+    // A family of a single pattern
+    template <typename F>
+    std::function<std::vector<std::string>(size_t)> single(F pattern) {
+        return [pattern](size_t n) { return std::vector<std::string> {pattern(n)}; };
+    }
+
+    using RegexTokens = std::vector<std::shared_ptr<pl0cc::RegexToken>>;
+
+    /*
+     * One pattern is built as is. Several are joined as in Lexer::buildAutomaton: pattern i marks
+     * its end states 2i+1 and its other states 2i, so the DFA keeps apart what each one accepts.
+     */
+    pl0cc::NondeterministicAutomaton buildJoined(const std::vector<RegexTokens>& patterns) {
+        if (patterns.size() == 1) return pl0cc::buildNfa(patterns[0]);
+        pl0cc::NondeterministicAutomaton nfa;
+        auto start = nfa.startSingleState();
+        for (size_t i = 0; i < patterns.size(); i++) {
+            auto sub = pl0cc::buildNfa(patterns[i]);
+            sub.addEndStateMarkup(int(i << 1) | 1);
+            for (pl0cc::NondeterministicAutomaton::SingleState s = 0; s < sub.stateCount(); s++) {
+                if (!sub.isStopState(s)) sub.addStateMarkup(s, int(i << 1));
+            }
+            nfa.addAutomaton(start, sub);
+        }
+        return nfa;
+    }
+
+    struct Measurement {
+        std::vector<double> seconds[STAGE_COUNT];
+        size_t peakBytes[STAGE_COUNT] {};
+        size_t nfaStates = 0, subsetStates = 0, simplifiedStates = 0;
+    };
+
+    // Runs f and records its time and the heap growth above the level it started at
+    template <typename F>
+    auto measure(Measurement& m, Stage stage, F&& f) {
+        size_t base = liveBytes;
+        peakBytes = liveBytes;
+        auto start = Clock::now();
+        auto result = f();
+        m.seconds[stage].push_back(std::chrono::duration<double>(Clock::now() - start).count());
+        m.peakBytes[stage] = std::max(m.peakBytes[stage], peakBytes - base);
+        return result;
+    }
+
+    Measurement run(const std::vector<std::string>& patterns, int repeat) {
+        Measurement m;
+        for (int r = 0; r < repeat; r++) {
+            auto tokens = measure(m, TOKENIZE, [&] {
+                std::vector<RegexTokens> all;
+                for (const std::string& pattern : patterns) all.push_back(pl0cc::regexTokenize(pattern));
+                return all;
+            });
+            auto nfa = measure(m, NFA, [&] { return buildJoined(tokens); });
+            auto subset = measure(m, SUBSET, [&] { return nfa.toDeterministic(false); });
+            pl0cc::DeterministicAutomaton simplified = subset;
+            measure(m, SIMPLIFY, [&] {
+                simplified.simplify();
+                return 0;
+            });
+            m.nfaStates = nfa.stateCount();
+            m.subsetStates = subset.stateCount();
+            m.simplifiedStates = simplified.stateCount();
+        }
+        return m;
+    }
+
+    double median(std::vector<double> samples) {
+        std::sort(samples.begin(), samples.end());
+        size_t mid = samples.size() / 2;
+        return samples.size() % 2 ? samples[mid] : (samples[mid - 1] + samples[mid]) / 2;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::vector<Family> families {
+        {"keywords", keywords, {8, 32, 128}},
+        {"alternation", single(alternation), {2, 4, 6, 8}},
+        {"class", single(characterClass), {8, 32, 90}},
+        {"blowup", single(blowup), {2, 4, 6, 8}},
+    };
+    std::string only;
+    std::vector<size_t> sizes;
+    int repeat = 5;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--family" && i + 1 < argc) {
+            only = argv[++i];
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            std::string list(argv[++i]);
+            for (size_t from = 0; from <= list.size();) {
+                size_t comma = std::min(list.find(',', from), list.size());
+                sizes.push_back(std::strtoull(list.substr(from, comma - from).c_str(), nullptr, 10));
+                from = comma + 1;
+            }
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else {
+            std::clog << "Usage: pl0cc_automaton_bench [--family <name>] [--sizes <n>,...] [--repeat <n>]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (!only.empty()) {
+        families.erase(std::remove_if(families.begin(), families.end(), [&](const Family& f) { return f.name != only; }),
+                       families.end());
+        if (families.empty()) {
+            std::clog << "pl0cc_automaton_bench: unknown family " << only << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::printf("%-12s %5s %8s %-9s %11s %11s %8s\n", "family", "n", "length", "stage", "median ms", "peak KiB", "states");
+    for (const Family& family : families) {
+        for (size_t n : sizes.empty() ? family.sizes : sizes) {
+            std::vector<std::string> patterns = family.patterns(n);
+            size_t length = 0;
+            for (const std::string& pattern : patterns) length += pattern.size();
+            Measurement m;
+            try {
+                m = run(patterns, repeat);
+            } catch (const std::runtime_error& e) {
+                std::clog << "pl0cc_automaton_bench: " << family.name << " " << n << ": " << e.what() << std::endl;
+                return EXIT_FAILURE;
+            }
+            const size_t states[STAGE_COUNT] {0, m.nfaStates, m.subsetStates, m.simplifiedStates};
+            for (int s = 0; s < STAGE_COUNT; s++) {
+                std::printf("%-12s %5zu %8zu %-9s %11.3f %11.1f ", family.name, n, length, stageNames[s],
+                            median(m.seconds[s]) * 1e3, double(m.peakBytes[s]) / 1024);
+                if (s == TOKENIZE) std::printf("%8s\n", "-");
+                else std::printf("%8zu\n", states[s]);
+            }
+            std::fflush(stdout);
+        }
+    }
+    return EXIT_SUCCESS;
+}
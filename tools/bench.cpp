@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "json.hpp"
+#include "lexer.hpp"
+#include "output_buffer.hpp"
+#include "program_generator.hpp"
+#include "syntax.hpp"
+
+/*
+ * End-to-end frontend benchmark on generated programs: lexes, LL(1)-parses and writes the
+ * text dump of every input size, repeat times after warmup rounds, and reports throughput in
+ * input bytes. Inputs above --unit are processed as a run of independent units of that size
+ * (seed, seed+1, ...), so 1G runs in the memory of one unit; a unit's generation is not timed.
+ * --backtracking lexes inputs that make the lexer back up to an earlier accept over and over
+ * instead; the time per byte stays flat across sizes as long as lexing is linear.
+ * --keyword-hash lexes with Lexer::KeywordMatching::PERFECT_HASH instead of the merged DFA.
+ *   pl0cc_bench --sizes 1K,1M,64M --repeat 5
+ *   pl0cc_bench --backtracking --sizes 64K,256K,1M
+ *   pl0cc_bench --generate 1M > big.pl0
+ */
+namespace {
+    enum Phase { LEX, PARSE, EMIT, PHASE_COUNT };
+    constexpr const char* phaseNames[] {"lex", "parse", "emit"};
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Statistics {
+        double min, median, mean, stddev;
+    };
+
+    Statistics statisticsOf(std::vector<double> samples) {
+        std::sort(samples.begin(), samples.end());
+        double sum = 0;
+        for (double s : samples) sum += s;
+        double mean = sum / double(samples.size());
+        double squares = 0;
+        for (double s : samples) squares += (s - mean) * (s - mean);
+        size_t mid = samples.size() / 2;
+        double median = samples.size() % 2 ? samples[mid] : (samples[mid - 1] + samples[mid]) / 2;
+        return {samples.front(), median, mean, samples.size() > 1 ? std::sqrt(squares / double(samples.size() - 1)) : 0};
+    }
+
+    // Accepts plain byte counts and K, M and G suffixes (powers of 1024)
+    bool parseSize(const std::string& text, size_t& size) {
+        char* end = nullptr;
+        unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+        if (end == text.c_str()) return false;
+        std::string suffix(end);
+        if (suffix == "K" || suffix == "k") value <<= 10;
+        else if (suffix == "M" || suffix == "m") value <<= 20;
+        else if (suffix == "G" || suffix == "g") value <<= 30;
+        else if (!suffix.empty()) return false;
+        size = size_t(value);
+        return value > 0;
+    }
+
+    std::string sizeName(size_t size) {
+        if (size % (1 << 30) == 0) return std::to_string(size >> 30) + "G";
+        if (size % (1 << 20) == 0) return std::to_string(size >> 20) + "M";
+        if (size % (1 << 10) == 0) return std::to_string(size >> 10) + "K";
+        return std::to_string(size);
+    }
+
+    struct Round {
+        double seconds[PHASE_COUNT] {};
+        size_t tokens = 0;
+        size_t nodes = 0;
+    };
+
+    void runUnit(const std::string& source, pl0cc::Lexer::KeywordMatching keywords,
+                 const pl0cc::Syntax& syntax, const pl0cc::LlMap& llMap, int sink, Round& round) {
+        auto start = Clock::now();
+        pl0cc::Lexer lexer(keywords);
+        lexer.feedString(source);
+        auto lexed = Clock::now();
+        if (lexer.errorCount() != 0) throw std::runtime_error("generated program has lexer errors");
+        pl0cc::SyntaxTree tree = pl0cc::llZeroParseSyntax(syntax, llMap, lexer.tokenStorage());
+        auto parsed = Clock::now();
+        {
+            pl0cc::OutputBuffer out(sink);
+            lexer.tokenStorage().serializeTo(out);
+            out.put("Syntax Tree:\n");
+            tree.serializeTo(out, pl0cc::symbols::symbolToName);
+        }
+        auto emitted = Clock::now();
+
+        round.seconds[LEX] += std::chrono::duration<double>(lexed - start).count();
+        round.seconds[PARSE] += std::chrono::duration<double>(parsed - lexed).count();
+        round.seconds[EMIT] += std::chrono::duration<double>(emitted - parsed).count();
+        round.tokens += lexer.tokenCount();
+        round.nodes += tree.nodeCount();
+    }
+
+    // Each pattern is repeated up to the input size
+    struct BacktrackingFamily {
+        const char* name;
+        const char* pattern;
+    };
+
+    constexpr BacktrackingFamily backtrackingFamilies[] {
+        {"comment-openers", "/*"},          // Every "/*" scans to the end before splitting into '/' '*'
+        {"exponents", "1.5e"},              // NUMBER backs up past an exponent without digits
+        {"mixed", "x/*.5e+ /*\n"},
+    };
+
+    void runBacktracking(const std::vector<size_t>& sizes, pl0cc::Lexer::KeywordMatching keywords,
+                         int repeat, int warmup, pl0cc::JsonValue& report) {
+        std::printf("%-6s %-16s %10s %10s %10s %12s\n", "size", "family", "min ms", "median ms", "ns/byte", "tokens");
+        for (size_t size : sizes) {
+            for (const BacktrackingFamily& family : backtrackingFamilies) {
+                std::string source;
+                while (source.size() < size) source += family.pattern;
+                source.resize(size);
+
+                std::vector<double> samples;
+                size_t tokens = 0;
+                for (int r = 0; r < warmup + repeat; r++) {
+                    auto start = Clock::now();
+                    pl0cc::Lexer lexer(keywords);
+                    lexer.feedString(source);
+                    auto lexed = Clock::now();
+                    tokens = lexer.tokenCount();
+                    if (r >= warmup) samples.push_back(std::chrono::duration<double>(lexed - start).count());
+                }
+
+                Statistics stats = statisticsOf(samples);
+                double nsPerByte = stats.median * 1e9 / double(size);
+                std::printf("%-6s %-16s %10.3f %10.3f %10.1f %12zu\n", sizeName(size).c_str(), family.name,
+                            stats.min * 1e3, stats.median * 1e3, nsPerByte, tokens);
+                std::fflush(stdout);
+                pl0cc::JsonValue& entry = report["backtracking"][family.name][sizeName(size)];
+                entry["input_bytes"] = size;
+                entry["tokens"] = tokens;
+                entry["min_seconds"] = stats.min;
+                entry["median_seconds"] = stats.median;
+                entry["ns_per_byte"] = nsPerByte;
+            }
+        }
+    }
+
+    // Nothing to do for an empty filename
+    bool writeReport(const std::string& jsonFilename, const pl0cc::JsonValue& report) {
+        if (jsonFilename.empty()) return true;
+        std::ofstream json(jsonFilename);
+        json << report.serialize() << '\n';
+        if (!json) {
+            std::clog << "pl0cc_bench: cannot write " << jsonFilename << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    const char* const usage =
+        "Usage: pl0cc_bench [--sizes <size>,...] [--repeat <n>] [--warmup <n>] [--unit <size>] [--json <file>]\n"
+        "                   [--seed <n>] [--depth <n>] [--expr-depth <n>] [--identifiers <n>] [--identifier-length <n>]\n"
+        "                   [--literals <share>] [--floats <share>] [--strings <share>] [--comments <density>]\n"
+        "                   [--keyword-hash]\n"
+        "       pl0cc_bench --backtracking [--keyword-hash] [--sizes <size>,...] [--repeat <n>] [--warmup <n>] [--json <file>]\n"
+        "       pl0cc_bench --generate <size> [generator options]\n";
+}
+
+int main(int argc, char **argv) {
+    pl0cc::GeneratorOptions generator;
+    std::vector<size_t> sizes {size_t(1) << 10, size_t(64) << 10, size_t(1) << 20, size_t(16) << 20};
+    size_t unit = size_t(4) << 20;
+    size_t generateSize = 0;
+    int repeat = 5;
+    int warmup = 1;
+    std::string jsonFilename;
+    bool backtracking = false;
+    auto keywords = pl0cc::Lexer::KeywordMatching::AUTOMATON;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--backtracking") {
+            backtracking = true;
+            continue;
+        }
+        if (arg == "--keyword-hash") {
+            keywords = pl0cc::Lexer::KeywordMatching::PERFECT_HASH;
+            continue;
+        }
+        bool hasValue = i + 1 < argc;
+        std::string value = hasValue ? argv[i + 1] : "";
+        bool ok = hasValue;
+        if (arg == "--sizes" && hasValue) {
+            sizes.clear();
+            for (size_t from = 0; ok && from <= value.size();) {
+                size_t comma = std::min(value.find(',', from), value.size());
+                size_t size = 0;
+                ok = parseSize(value.substr(from, comma - from), size);
+                sizes.push_back(size);
+                from = comma + 1;
+            }
+        } else if (arg == "--unit" && hasValue) {
+            ok = parseSize(value, unit);
+        } else if (arg == "--generate" && hasValue) {
+            ok = parseSize(value, generateSize);
+        } else if (arg == "--repeat" && hasValue) {
+            repeat = std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--warmup" && hasValue) {
+            warmup = std::max(0, std::atoi(value.c_str()));
+        } else if (arg == "--json" && hasValue) {
+            jsonFilename = value;
+        } else if (arg == "--seed" && hasValue) {
+            generator.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--depth" && hasValue) {
+            generator.maxDepth = unsigned(std::max(0, std::atoi(value.c_str())));
+        } else if (arg == "--expr-depth" && hasValue) {
+            generator.maxExpressionDepth = unsigned(std::max(0, std::atoi(value.c_str())));
+        } else if (arg == "--identifiers" && hasValue) {
+            generator.identifierCount = unsigned(std::max(1, std::atoi(value.c_str())));
+        } else if (arg == "--identifier-length" && hasValue) {
+            generator.identifierLength = unsigned(std::max(1, std::atoi(value.c_str())));
+        } else if (arg == "--literals" && hasValue) {
+            generator.literalShare = std::atof(value.c_str());
+        } else if (arg == "--floats" && hasValue) {
+            generator.floatShare = std::atof(value.c_str());
+        } else if (arg == "--strings" && hasValue) {
+            generator.stringShare = std::atof(value.c_str());
+        } else if (arg == "--comments" && hasValue) {
+            generator.commentDensity = std::atof(value.c_str());
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::clog << usage;
+            return EXIT_FAILURE;
+        }
+        i++;
+    }
+    if (generator.floatShare + generator.stringShare > 1) {
+        std::clog << "pl0cc_bench: --floats and --strings add up to more than 1" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (generateSize > 0) {
+        generator.targetBytes = generateSize;
+        std::string program = pl0cc::generateProgram(generator);
+        std::cout.write(program.data(), std::streamsize(program.size()));
+        return std::cout.flush() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    const size_t dfaStates = pl0cc::Lexer::getDFA(keywords).stateCount();
+    std::printf("lexer DFA: %zu states\n", dfaStates);
+    if (backtracking) {
+        pl0cc::JsonValue report;
+        report["repeat"] = repeat;
+        report["dfa_states"] = dfaStates;
+        runBacktracking(sizes, keywords, repeat, warmup, report);
+        return writeReport(jsonFilename, report) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    const pl0cc::Syntax syntax = pl0cc::genSyntax();
+    const pl0cc::LlMap llMap = syntax.llMap();
+    pl0cc::symbols::symbolToNameMap();
+    int sink = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (sink < 0) {
+        std::clog << "pl0cc_bench: cannot open /dev/null" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    pl0cc::JsonValue report;
+    report["repeat"] = repeat;
+    report["seed"] = generator.seed;
+    report["dfa_states"] = dfaStates;
+    std::printf("%-6s %-6s %10s %10s %10s %10s %10s %12s\n",
+                "size", "phase", "min ms", "median ms", "mean ms", "stddev ms", "MiB/s", "tokens");
+    for (size_t size : sizes) {
+        // Whole units, then one shorter unit for the rest
+        std::vector<pl0cc::GeneratorOptions> units;
+        for (size_t done = 0; done < size; done += unit) {
+            units.push_back(generator);
+            units.back().seed = generator.seed + units.size() - 1;
+            units.back().targetBytes = std::min(unit, size - done);
+        }
+        // Small inputs are generated once; large ones again for every round
+        std::vector<std::string> sources;
+        if (units.size() == 1) sources.push_back(pl0cc::generateProgram(units[0]));
+
+        std::vector<double> samples[PHASE_COUNT];
+        Round round;
+        size_t inputBytes = 0;
+        try {
+            for (int r = 0; r < warmup + repeat; r++) {
+                round = Round();
+                inputBytes = 0;
+                for (const pl0cc::GeneratorOptions& options : units) {
+                    std::string source = sources.empty() ? pl0cc::generateProgram(options) : sources[0];
+                    inputBytes += source.size();
+                    runUnit(source, keywords, syntax, llMap, sink, round);
+                }
+                if (r < warmup) continue;
+                for (int p = 0; p < PHASE_COUNT; p++) samples[p].push_back(round.seconds[p]);
+            }
+        } catch (std::tuple<int, int, int> err) {
+            std::clog << "pl0cc_bench: generated program does not parse at line " << std::get<1>(err) + 1 << std::endl;
+            return EXIT_FAILURE;
+        } catch (const std::runtime_error& e) {
+            std::clog << "pl0cc_bench: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        pl0cc::JsonValue& entry = report["sizes"][sizeName(size)];
+        entry["input_bytes"] = inputBytes;
+        entry["tokens"] = round.tokens;
+        entry["tree_nodes"] = round.nodes;
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            Statistics stats = statisticsOf(samples[p]);
+            double mibPerSecond = stats.median > 0 ? double(inputBytes) / double(1 << 20) / stats.median : 0;
+            std::printf("%-6s %-6s %10.3f %10.3f %10.3f %10.3f %10.1f %12zu\n",
+                        sizeName(size).c_str(), phaseNames[p], stats.min * 1e3, stats.median * 1e3,
+                        stats.mean * 1e3, stats.stddev * 1e3, mibPerSecond, round.tokens);
+            pl0cc::JsonValue& phase = entry["phases"][phaseNames[p]];
+            phase["min_seconds"] = stats.min;
+            phase["median_seconds"] = stats.median;
+            phase["mean_seconds"] = stats.mean;
+            phase["stddev_seconds"] = stats.stddev;
+            phase["bytes_per_second"] = stats.median > 0 ? double(inputBytes) / stats.median : 0;
+        }
+        std::fflush(stdout);
+    }
+    ::close(sink);
+    return writeReport(jsonFilename, report) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,83 @@
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "binary_output.hpp"
+#include "output_buffer.hpp"
+#include "syntax.hpp"
+
+/*
+ * Prints a --emit=binary file as the text dump pl0cc writes by default, reading it through
+ * BinaryOutputView. Doubles as an example client of the reader and as a round-trip check:
+ *   pl0cc a.pl0 -o a.txt && pl0cc a.pl0 --emit=binary -o a.bin && pl0cc_binary_dump a.bin | cmp - a.txt
+ */
+namespace {
+    void dumpPool(pl0cc::OutputBuffer& out, const char* title, size_t count,
+                  std::string_view (pl0cc::BinaryOutputView::*entry)(size_t) const, const pl0cc::BinaryOutputView& view) {
+        out.put(title);
+        out.put("Index  Value\n");
+        for (size_t i = 0; i < count; i++) {
+            out.putUnsignedPadded(i, 7);
+            out.put((view.*entry)(i));
+            out.put('\n');
+        }
+        out.put('\n');
+    }
+
+    void dump(const pl0cc::BinaryOutputView& view, pl0cc::OutputBuffer& out) {
+        out.put("Tokens >--------------------\n");
+        out.put("Type            Seman\n");
+        for (size_t i = 0; i < view.tokenCount(); i++) {
+            pl0cc::TokenType type = view.tokenType(i);
+            out.putUnsignedPadded(unsigned(type), 2);
+            out.putPadded("(" + pl0cc::tokenTypeName(type) + ")", 14);
+            if (view.tokenSeman(i) == -1) {
+                out.put('^');
+            } else {
+                out.putInt(view.tokenSeman(i));
+            }
+            out.put('\n');
+        }
+        out.put('\n');
+        dumpPool(out, "Symbols >-------------------\n", view.symbolCount(), &pl0cc::BinaryOutputView::symbol, view);
+        dumpPool(out, "Numbers >-------------------\n", view.numberCount(), &pl0cc::BinaryOutputView::numberConstant, view);
+        dumpPool(out, "Strings >-------------------\n", view.stringCount(), &pl0cc::BinaryOutputView::stringConstant, view);
+
+        out.put("Syntax Tree:\n");
+        if (view.nodeCount() == 0) return;
+        std::vector<std::pair<size_t, size_t>> pending {{0, 0}};
+        while (!pending.empty()) {
+            auto [index, depth] = pending.back();
+            pending.pop_back();
+            const pl0cc::BinaryNode& node = view.node(index);
+            out.putRepeated('|', depth);
+            out.put(pl0cc::symbols::symbolToName(node.symbol));
+            if (node.hasToken()) {
+                out.put(" with token seman ");
+                out.putInt(node.seman);
+            }
+            out.put('\n');
+            for (size_t ch = node.childCount; ch-- > 0;) pending.emplace_back(view.child(index, ch), depth + 1);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " <binary output>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    try {
+        pl0cc::MappedFile file(argv[1]);
+        pl0cc::BinaryOutputView view(file.data(), file.size());
+        pl0cc::OutputBuffer out(STDOUT_FILENO);
+        dump(view, out);
+        return out.flush() ? EXIT_SUCCESS : EXIT_FAILURE;
+    } catch (const std::runtime_error& e) {
+        std::cerr << argv[1] << ": " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
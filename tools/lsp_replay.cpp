@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+#include "lsp_server.hpp"
+
+/*
+ * Replays language-server sessions recorded with `pl0cc --lsp --lsp-record <file>`
+ * (one JSON-RPC message per line) and reports the handling latency per method.
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::clog << "Usage: pl0cc_lsp_replay <session.jsonl>... [--repeat <n>]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> sessions;
+    int repeat = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--repeat" && i + 1 < argc) repeat = std::max(1, std::atoi(argv[++i]));
+        else sessions.push_back(arg);
+    }
+
+    std::map<std::string, std::vector<double>> latencies;   // Microseconds per method
+    for (const std::string& path : sessions) {
+        std::ifstream input(path);
+        if (!input) {
+            std::clog << "pl0cc_lsp_replay: cannot open " << path << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::vector<pl0cc::JsonValue> messages;
+        std::string line;
+        while (std::getline(input, line)) {
+            if (!line.empty()) messages.push_back(pl0cc::JsonValue::parse(line));
+        }
+
+        for (int round = 0; round < repeat; round++) {
+            pl0cc::LspServer server;
+            for (const pl0cc::JsonValue& message : messages) {
+                auto start = std::chrono::steady_clock::now();
+                server.handle(message);
+                auto elapsed = std::chrono::steady_clock::now() - start;
+
+                const pl0cc::JsonValue& method = message["method"];
+                if (method.type() != pl0cc::JsonValue::Type::STRING) continue;
+                latencies[method.asString()].push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+            }
+        }
+    }
+
+    std::printf("%-36s %8s %10s %10s %10s %10s\n", "method", "count", "p50 us", "p95 us", "p99 us", "max us");
+    for (auto& [method, samples] : latencies) {
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&](double p) { return samples[size_t(p * double(samples.size() - 1))]; };
+        std::printf("%-36s %8zu %10.1f %10.1f %10.1f %10.1f\n", method.c_str(), samples.size(),
+                    percentile(0.50), percentile(0.95), percentile(0.99), samples.back());
+    }
+    return EXIT_SUCCESS;
+}
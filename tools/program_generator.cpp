@@ -0,0 +1,267 @@
+#include "program_generator.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+using namespace pl0cc;
+
+namespace {
+    constexpr const char* syllables[] {"ka", "lo", "mi", "ne", "ru", "sa", "ti", "vo", "ex", "ul"};
+    constexpr const char* types[] {"int", "float", "char"};
+    constexpr const char* binaryOperators[] {
+        "+", "-", "*", "/", "%", "+", "-", "*", ">", ">=", "<", "<=", "!=", "==", "&&", "||"
+    };
+    constexpr const char* unaryOperators[] {"-", "!", "+"};
+    constexpr const char* words[] {"alpha", "beta", "gamma", "delta", "value", "count", "total", "step"};
+
+    struct Function {
+        std::string name;
+        unsigned parameterCount;
+    };
+
+    class Generator {
+    public:
+        explicit Generator(const GeneratorOptions& options) : options(options), state(options.seed) {
+            out.reserve(options.targetBytes + 4096);
+        }
+
+        std::string run() {
+            out += "// generated by pl0cc_bench, seed " + std::to_string(options.seed) + "\n";
+            while (out.size() < options.targetBytes) {
+                maybeComment(0);
+                if (chance(0.2)) {
+                    out += types[below(3)];
+                    out += " g_" + std::to_string(globalCount++) + ",\n";
+                } else {
+                    function();
+                }
+            }
+            return std::move(out);
+        }
+    private:
+        const GeneratorOptions& options;
+        std::uint64_t state;
+        std::string out;
+        std::vector<Function> functions;
+        std::vector<std::string> names;
+        unsigned globalCount = 0;
+
+        // splitmix64
+        std::uint64_t next() {
+            std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+        size_t below(size_t bound) { return size_t(next() % bound); }
+        bool chance(double p) { return double(next() >> 11) * 0x1.0p-53 < p; }
+
+        std::string identifier(const char* prefix, size_t index) {
+            std::string name = prefix;
+            // Lengths spread around identifierLength; the numbered suffix keeps names apart from keywords
+            size_t length = options.identifierLength / 2 + below(options.identifierLength + 1);
+            while (name.size() < length) name += syllables[below(std::size(syllables))];
+            return name + "_" + std::to_string(index);
+        }
+
+        void indent(unsigned depth) { out.append(size_t(depth) * 4, ' '); }
+
+        void maybeComment(unsigned depth) {
+            if (!chance(options.commentDensity)) return;
+            indent(depth);
+            if (chance(0.7)) {
+                out += "// ";
+                sentence(2 + below(8));
+            } else {
+                out += "/* ";
+                sentence(2 + below(8));
+                if (chance(0.5)) {
+                    out += '\n';
+                    indent(depth);
+                    out += "   ";
+                    sentence(2 + below(8));
+                }
+                out += " */";
+            }
+            out += '\n';
+        }
+
+        void sentence(size_t wordCount) {
+            for (size_t i = 0; i < wordCount; i++) {
+                if (i > 0) out += ' ';
+                out += words[below(std::size(words))];
+            }
+        }
+
+        void literal() {
+            if (chance(options.stringShare)) {
+                out += '"';
+                sentence(1 + below(4));
+                // An escaped quote never ends the literal, the lexer rejects a trailing backslash
+                if (chance(0.2)) {
+                    out += " \\\" ";
+                    sentence(1);
+                }
+                out += '"';
+            } else if (chance(options.floatShare / (1 - options.stringShare))) {
+                if (chance(0.8)) out += std::to_string(below(1000));
+                out += '.';
+                out += std::to_string(below(100));
+                if (chance(0.3)) {
+                    out += "eE"[below(2)];
+                    if (chance(0.5)) out += "+-"[below(2)];
+                    out += std::to_string(1 + below(30));
+                }
+            } else {
+                out += std::to_string(below(4) == 0 ? below(10) : below(100000));
+            }
+        }
+
+        void call(unsigned depth) {
+            const Function& callee = functions[below(functions.size())];
+            out += callee.name;
+            out += '(';
+            for (unsigned i = 0; i < callee.parameterCount; i++) {
+                if (i > 0) out += ", ";
+                expression(depth);
+            }
+            out += ')';
+        }
+
+        void operand(unsigned depth) {
+            if (chance(options.literalShare)) {
+                literal();
+            } else if (!functions.empty() && depth > 0 && chance(0.1)) {
+                call(depth - 1);
+            } else {
+                out += names[below(names.size())];
+            }
+        }
+
+        void expression(unsigned depth) {
+            if (depth == 0 || chance(0.35)) {
+                operand(depth);
+                return;
+            }
+            switch (below(6)) {
+                case 0:
+                    out += unaryOperators[below(std::size(unaryOperators))];
+                    if (chance(0.5)) {
+                        out += '(';
+                        expression(depth - 1);
+                        out += ')';
+                    } else {
+                        operand(depth - 1);
+                    }
+                    break;
+                case 1:
+                    out += '(';
+                    expression(depth - 1);
+                    out += ')';
+                    break;
+                default:
+                    // Spaces keep "/" "/" and "-" ">" from lexing as a comment or an arrow
+                    expression(depth - 1);
+                    out += ' ';
+                    out += binaryOperators[below(std::size(binaryOperators))];
+                    out += ' ';
+                    expression(depth - 1);
+                    break;
+            }
+        }
+
+        void body(unsigned depth, bool inLoop) {
+            if (depth >= options.maxDepth || chance(0.2)) {
+                out += '\n';
+                statement(depth + 1, inLoop);
+                return;
+            }
+            out += " {\n";
+            for (size_t n = 1 + below(5); n > 0; n--) statement(depth + 1, inLoop);
+            indent(depth);
+            out += '}';
+        }
+
+        void statement(unsigned depth, bool inLoop) {
+            maybeComment(depth);
+            indent(depth);
+            bool nested = depth < options.maxDepth;
+            size_t pick = below(100);
+            if (pick < 15) {
+                out += types[below(3)];
+                out += ' ';
+                out += names[below(names.size())];
+                out += ';';
+            } else if (pick < 50) {
+                out += names[below(names.size())];
+                out += " = ";
+                expression(options.maxExpressionDepth);
+                out += ';';
+            } else if (pick < 58 && !functions.empty()) {
+                call(options.maxExpressionDepth);
+                out += ';';
+            } else if (pick < 72 && nested) {
+                out += "if (";
+                expression(options.maxExpressionDepth);
+                out += ')';
+                body(depth, inLoop);
+                if (chance(0.4)) {
+                    if (out.back() == '}') {
+                        out += ' ';
+                    } else {
+                        indent(depth);
+                    }
+                    out += "else";
+                    body(depth, inLoop);
+                }
+            } else if (pick < 82 && nested) {
+                out += "while (";
+                expression(options.maxExpressionDepth);
+                out += ')';
+                body(depth, true);
+            } else if (pick < 86 && nested) {
+                out += "{\n";
+                for (size_t n = below(4); n > 0; n--) statement(depth + 1, inLoop);
+                indent(depth);
+                out += '}';
+            } else if (pick < 94 && inLoop) {
+                out += chance(0.5) ? "break;" : "continue;";
+            } else {
+                out += "return ";
+                expression(options.maxExpressionDepth);
+                out += ';';
+            }
+            // A body on its own line already ended with one
+            if (out.back() != '\n') out += '\n';
+        }
+
+        void function() {
+            Function f {identifier("fn_", functions.size()), unsigned(1 + below(3))};
+            names.clear();
+            for (unsigned i = 0; i < std::max(options.identifierCount, 1u); i++) names.push_back(identifier("", i));
+
+            out += "fn " + f.name + "(";
+            for (unsigned i = 0; i < f.parameterCount; i++) {
+                if (i > 0) out += ", ";
+                out += types[below(3)];
+                out += ' ';
+                out += names[i % names.size()];
+            }
+            out += ") -> ";
+            out += types[below(3)];
+            out += " {\n";
+            for (size_t n = 3 + below(10); n > 0; n--) statement(1, false);
+            indent(1);
+            out += "return ";
+            expression(options.maxExpressionDepth);
+            out += ";\n}\n";
+            // Added last, so that only earlier functions are called
+            functions.push_back(std::move(f));
+        }
+    };
+}
+
+std::string pl0cc::generateProgram(const GeneratorOptions& options) {
+    return Generator(options).run();
+}
@@ -0,0 +1,29 @@
+#ifndef PL0CC_PROGRAM_GENERATOR_HPP
+#define PL0CC_PROGRAM_GENERATOR_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace pl0cc {
+    struct GeneratorOptions {
+        std::uint64_t seed = 1;
+        size_t targetBytes = 64 << 10;     // Stops after the first function that reaches it
+        unsigned maxDepth = 4;             // Nesting of blocks, if and while
+        unsigned maxExpressionDepth = 3;
+        unsigned identifierCount = 64;     // Distinct variable names per function
+        unsigned identifierLength = 6;     // Typical name length; numbered suffixes come on top
+        double literalShare = 0.4;         // Operands that are literals rather than names or calls
+        double floatShare = 0.3;           // Of the literals: floating point numbers
+        double stringShare = 0.1;          // Of the literals: strings
+        double commentDensity = 0.1;       // Comments per statement
+    };
+
+    /*
+     * Writes a syntactically valid program for genSyntax() that lexes without errors. The same
+     * options always produce the same bytes, on every platform, because the generator uses its
+     * own random number generator and distributions.
+     */
+    std::string generateProgram(const GeneratorOptions& options);
+}
+
+#endif // PL0CC_PROGRAM_GENERATOR_HPP
@@ -0,0 +1,19 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "rd_codegen.hpp"
+#include "syntax.hpp"
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::clog << "Usage: pl0cc_rdgen <output header>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream output(argv[1]);
+    pl0cc::generateRecursiveDescentParser(pl0cc::genSyntax(), output, "RecursiveDescentParser");
+    output.close();
+
+    return output ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,117 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "incremental_parser.hpp"
+#include "lexer.hpp"
+#include "regex.hpp"
+#include "syntax.hpp"
+
+/*
+ * Lexes and parses on many threads at once, all of them starting together so that the first
+ * uses of the lexer DFA, a shared Regex, the name map and the FIRST/FOLLOW sets of a shared
+ * Syntax race each other. Every thread must produce the single-threaded result.
+ * Build with -DPL0CC_SANITIZE_THREAD=ON to have ThreadSanitizer check the run.
+ */
+namespace {
+    const char* const program =
+        "// stress program\n"
+        "int g,\n"
+        "fn add(int a, int b) -> int {\n"
+        "    return a + b * 2;\n"
+        "}\n"
+        "/* multi\n"
+        "   line */\n"
+        "fn main() -> int {\n"
+        "    int x;\n"
+        "    float y;\n"
+        "    x = 3;\n"
+        "    y = .5e3;\n"
+        "    while (x < 10) {\n"
+        "        if (x == 5) x = x + 1; else { x = add(x, 2); }\n"
+        "        print(\"hello \\\" world\");\n"
+        "    }\n"
+        "    return -x;\n"
+        "}\n";
+
+    std::string compile(const pl0cc::Syntax& syntax, const pl0cc::LlMap& llMap) {
+        pl0cc::Lexer lexer;
+        for (const char* p = program; *p != '\0'; p++) lexer.feedChar(*p);
+        lexer.eof();
+
+        std::ostringstream out;
+        lexer.tokenStorage().serializeTo(out);
+        pl0cc::llZeroParseSyntax(syntax, llMap, lexer.tokenStorage()).serializeTo(out, pl0cc::symbols::symbolToName);
+
+        // Edit and reparse incrementally; the tree must match a full parse
+        pl0cc::IncrementalParser parser(syntax, llMap);
+        parser.parse(lexer.tokenStorage());
+        std::string source = lexer.sourceText();
+        auto edit = lexer.applyEdit(source.find("x = 3"), 5, "x = add(1, 2)");
+        parser.reparse(lexer.tokenStorage(), edit);
+        parser.tree().serializeTo(out, pl0cc::symbols::symbolToName);
+        return out.str();
+    }
+
+    // A one-statement edit must reparse fewer tokens than the whole stream, into the full-parse tree
+    bool reparsesIncrementally(const pl0cc::Syntax& syntax, const pl0cc::LlMap& llMap) {
+        pl0cc::Lexer lexer;
+        lexer.feedString(program);
+        pl0cc::IncrementalParser parser(syntax, llMap);
+        parser.parse(lexer.tokenStorage());
+        const size_t fullCount = parser.reparsedTokenCount();
+        std::string source = lexer.sourceText();
+        auto edit = lexer.applyEdit(source.find("x = 3"), 5, "x = 4");
+        parser.reparse(lexer.tokenStorage(), edit);
+
+        std::ostringstream incremental, full;
+        parser.tree().serializeTo(incremental, pl0cc::symbols::symbolToName);
+        pl0cc::llZeroParseSyntax(syntax, llMap, lexer.tokenStorage()).serializeTo(full, pl0cc::symbols::symbolToName);
+        std::cout << "edit reparsed " << parser.reparsedTokenCount() << " of " << fullCount << " tokens" << std::endl;
+        return parser.reparsedTokenCount() < fullCount && incremental.str() == full.str();
+    }
+}
+
+int main(int argc, char **argv) {
+    const int threadCount = argc > 1 ? std::atoi(argv[1]) : 64;
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    // Shared and still cold: nothing below has been used yet
+    const pl0cc::Syntax syntax = pl0cc::genSyntax();
+    const pl0cc::Regex number("[0-9]+");
+
+    std::atomic<int> arrived(0);
+    std::vector<std::string> results(static_cast<size_t>(threadCount));
+    std::vector<int> mismatches(static_cast<size_t>(threadCount), 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t] {
+            arrived++;
+            while (arrived < threadCount) std::this_thread::yield();
+
+            if (!number.match("2024") || number.match("20x")) mismatches[size_t(t)]++;
+            const pl0cc::LlMap llMap = syntax.llMap();
+            for (int i = 0; i < iterations; i++) {
+                std::string result = compile(syntax, llMap);
+                if (i == 0) results[size_t(t)] = std::move(result);
+                else if (result != results[size_t(t)]) mismatches[size_t(t)]++;
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+
+    const pl0cc::Syntax reference = pl0cc::genSyntax();
+    const std::string expected = compile(reference, reference.llMap());
+    int failures = 0;
+    for (int t = 0; t < threadCount; t++) {
+        if (results[size_t(t)] != expected || mismatches[size_t(t)] != 0) failures++;
+    }
+    std::cout << threadCount << " threads x " << iterations << " iterations, "
+              << failures << " threads with differing results" << std::endl;
+    const bool incremental = reparsesIncrementally(reference, reference.llMap());
+    return failures == 0 && incremental ? EXIT_SUCCESS : EXIT_FAILURE;
+}